@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "analytics_store.hpp"
+#include "synthetic_rows.hpp"
+
+using json = nlohmann::json;
+
+struct Summary
+{
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double total = 0.0;
+};
+
+Summary summarize(std::vector<double> samples)
+{
+    Summary summary;
+    if (samples.empty())
+    {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    summary.p50 = samples[samples.size() / 2];
+    summary.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    for (double sample : samples)
+    {
+        summary.total += sample;
+    }
+    return summary;
+}
+
+// Runs `body` `iterations` times and returns the per-iteration latencies in seconds.
+std::vector<double> measure(size_t iterations, const std::function<void()> &body)
+{
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return samples;
+}
+
+void report(const std::string &name, size_t rows, size_t itemsPerIteration, const std::vector<double> &samples)
+{
+    Summary summary = summarize(samples);
+    double throughput = summary.total > 0.0 ? samples.size() * itemsPerIteration / summary.total : 0.0;
+    std::cout << std::left << std::setw(18) << name
+              << std::right << std::setw(12) << rows
+              << std::setw(14) << std::fixed << std::setprecision(1) << summary.p50 * 1e6
+              << std::setw(14) << summary.p99 * 1e6
+              << std::setw(16) << std::setprecision(0) << throughput << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t maxRows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const size_t batchSize = 1000;
+    std::mt19937 rng(42);
+
+    std::cout << std::left << std::setw(18) << "benchmark"
+              << std::right << std::setw(12) << "rows"
+              << std::setw(14) << "p50 (us)"
+              << std::setw(14) << "p99 (us)"
+              << std::setw(16) << "rows/s" << std::endl;
+
+    // JSON parse of an "analytics" message carrying one batch
+    json analyticsMessage = {
+        {"requestType", "analytics"},
+        {"requestID", 1},
+        {"Data", generateRows(batchSize, rng)}};
+    std::string message = analyticsMessage.dump();
+    report("parse", batchSize, batchSize, measure(200, [&]()
+                                                  {
+        json parsed = json::parse(message);
+        std::vector<std::vector<std::string>> data = parsed["Data"];
+        if (data.size() != batchSize)
+        {
+            std::abort();
+        } }));
+
+    // Ingest and query at growing store sizes: 1K, 10K, ... up to maxRows
+    AnalyticsStore store;
+    size_t nextRow = 0;
+    for (size_t target = 1000; target <= maxRows; target *= 10)
+    {
+        std::vector<double> ingestSamples;
+        while (store.size() < target)
+        {
+            std::vector<std::vector<std::string>> batch = generateRows(std::min(batchSize, target - store.size()), rng, nextRow);
+            nextRow += batch.size();
+            auto start = std::chrono::steady_clock::now();
+            IngestResult ingested;
+            try
+            {
+                ingested = store.ingest(batch);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Ingest failed at " << store.size() << " rows: " << e.what() << std::endl;
+                return 1;
+            }
+            ingestSamples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            if (ingested.stored < batch.size())
+            {
+                std::cerr << "Ingest stored " << ingested.stored << " of " << batch.size() << " rows at " << store.size() << " rows ("
+                          << ingested.duplicates << " duplicates, " << ingested.malformed << " malformed, " << ingested.rejected << " rejected)" << std::endl;
+                return 1;
+            }
+        }
+        report("ingest", target, batchSize, ingestSamples);
+
+        size_t iterations = std::max<size_t>(3, std::min<size_t>(100, 10000000 / target));
+        for (int queryType : {0, 1})
+        {
+            report("query " + std::to_string(queryType), target, target, measure(iterations, [&]()
+                                                                                 { store.query(queryType); }));
+        }
+        report("query 0 PM2.5", target, target, measure(iterations, [&]()
+                                                       { store.query(0, "PM2.5"); }));
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+// Evaluation of "query" messages against an AnalyticsStore.
+//
+// Returns the result fields of the query response (the caller adds
+// requestType and requestID). Query types:
+//   0  area with the maximum average value         {"maxArea", "maxAverage"}
+//   1  area with the maximum single value          {"maxArea", "maxAqi"}
+//   2  value quantiles per area                    {"areas": {name: {"p50", ...}}}
+//        optional "area", "quantiles" (default [0.5, 0.95, 0.99])
+//   3  distinct monitoring sites per area          {"areas": {name: {"distinctSites"}}}
+//        optional "area"
+//   4  top-K areas by average or max value         {"topAreas": [{"area", "value", "sum", "count", "max"}]}
+//        optional "k" (default 10), "metric": "average" | "max" (default "average")
+//   5  aggregate over a region                      {"count", "average", "max", "maxArea", "maxSite",
+//                                                   "maxLatitude", "maxLongitude", "cells"}
+//        "bbox": [minLat, minLon, maxLat, maxLon] or "center": [lat, lon] with
+//        "radiusKm"; optional "groupByCell": true for per-grid-cell aggregates
+// Every type accepts an optional "pollutant" (e.g. "PM2.5") restricting it to
+// that parameter's partition; without it all pollutants are combined.
+// Types 2 and 3 accept "includeSketches": true to return the serialized
+// sketches so results from several analytics nodes can be merged; type 4
+// returns per-area sum/count/max for the same reason: summing sum and count
+// and taking the max of max per area, then re-ranking, combines top-K lists
+// (exactly, if each node was asked for at least as many areas as it holds).
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "analytics_store.hpp"
+
+inline std::string quantileLabel(double q)
+{
+    std::ostringstream label;
+    label << "p" << q * 100.0;
+    return label.str();
+}
+
+inline nlohmann::json topAreaJson(const std::string &area, const GroupAccumulator &totals, double value)
+{
+    return {{"area", area}, {"value", value}, {"sum", totals.sum}, {"count", totals.count}, {"max", totals.max}};
+}
+
+inline nlohmann::json evaluateQuery(const AnalyticsStore &store, const nlohmann::json &queryMessage)
+{
+    using json = nlohmann::json;
+    int queryType = queryMessage.at("query");
+    std::string pollutant = queryMessage.value("pollutant", "");
+
+    if (queryType == 2 || queryType == 3)
+    {
+        std::string area = queryMessage.value("area", "");
+        bool includeSketches = queryMessage.value("includeSketches", false);
+        std::vector<double> quantiles = queryMessage.value("quantiles", std::vector<double>{0.5, 0.95, 0.99});
+
+        json perArea = json::object();
+        store.forEachAreaSketch(area, [&](const std::string &name, const AreaSketches &sketches)
+                                {
+            json entry;
+            if (queryType == 2)
+            {
+                for (double q : quantiles)
+                {
+                    entry[quantileLabel(q)] = sketches.values.quantile(q);
+                }
+                entry["count"] = sketches.values.count();
+                if (includeSketches)
+                {
+                    entry["digest"] = sketches.values.toJson();
+                }
+            }
+            else
+            {
+                entry["distinctSites"] = std::llround(sketches.sites.estimate());
+                if (includeSketches)
+                {
+                    entry["hll"] = sketches.sites.toJson();
+                }
+            }
+            perArea[name] = entry; },
+                                pollutant);
+        return {{"areas", perArea}};
+    }
+
+    if (queryType == 4)
+    {
+        size_t k = static_cast<size_t>(std::max(0, queryMessage.value("k", 10)));
+        bool byAverage = queryMessage.value("metric", "average") != "max";
+        json topAreas = json::array();
+        for (const auto &entry : store.topAreas(k, byAverage, pollutant))
+        {
+            topAreas.push_back(topAreaJson(entry.area, entry.totals, entry.value));
+        }
+        return {{"topAreas", topAreas}};
+    }
+
+    if (queryType == 5)
+    {
+        GeoRegion region;
+        if (queryMessage.contains("center"))
+        {
+            const json &center = queryMessage.at("center");
+            region = GeoRegion::circle(center.at(0).get<double>(), center.at(1).get<double>(), queryMessage.value("radiusKm", 50.0));
+        }
+        else
+        {
+            const json &bbox = queryMessage.at("bbox");
+            region = GeoRegion::boundingBox(bbox.at(0).get<double>(), bbox.at(1).get<double>(), bbox.at(2).get<double>(), bbox.at(3).get<double>());
+        }
+
+        GeoQueryResult result = store.geoQuery(region, queryMessage.value("groupByCell", false), pollutant);
+        json queryResult = {
+            {"count", result.totals.count},
+            {"average", result.totals.average()},
+            {"max", result.totals.count > 0 ? result.totals.max : 0.0},
+            {"maxArea", result.maxArea},
+            {"maxSite", result.maxSite},
+            {"maxLatitude", result.maxLatitude},
+            {"maxLongitude", result.maxLongitude}};
+        if (queryMessage.value("groupByCell", false))
+        {
+            json cells = json::array();
+            for (const auto &[key, totals] : result.cells)
+            {
+                cells.push_back({{"lat", GeoGridIndex::cellLat(key)},
+                                 {"lon", GeoGridIndex::cellLon(key)},
+                                 {"count", totals.count},
+                                 {"average", totals.average()},
+                                 {"max", totals.max}});
+            }
+            queryResult["cells"] = cells;
+        }
+        return queryResult;
+    }
+
+    QueryResult result = store.query(queryType, pollutant);
+    json queryResult = {{"maxArea", result.maxArea}};
+    if (queryType == 0)
+    {
+        queryResult["maxAverage"] = result.maxValue;
+    }
+    else
+    {
+        queryResult["maxAqi"] = result.maxValue;
+    }
+    return queryResult;
+}
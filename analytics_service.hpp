@@ -0,0 +1,221 @@
+#pragma once
+
+// Request handlers of an analytics node: "Init Analytics", "analytics"
+// (ingest a batch of rows), "bulk load" (ingest a server-local file) and
+// "query", over the node's store, query cache and recent-request table.
+// install() registers them with a ServerCore.
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+#include "analytics_queries.hpp"
+#include "analytics_store.hpp"
+#include "bulk_loader.hpp"
+#include "logger.hpp"
+#include "query_cache.hpp"
+#include "recent_requests.hpp"
+#include "request_type.hpp"
+#include "server_core.hpp"
+#include "sketches.hpp"
+
+class AnalyticsService
+{
+public:
+    void install(ServerCore &server)
+    {
+        this->server = &server;
+        server.on(RequestType::InitAnalytics, [this](const nlohmann::json &message, const std::string &)
+                  { handleInitAnalytics(message); });
+        server.on(RequestType::Analytics, [this](const nlohmann::json &message, const std::string &)
+                  { handleAnalytics(message); });
+        server.on(RequestType::BulkLoad, [this](const nlohmann::json &message, const std::string &)
+                  { handleBulkLoad(message); });
+        server.on(RequestType::Query, [this](const nlohmann::json &message, const std::string &)
+                  { handleQuery(message); });
+    }
+
+private:
+    void handleInitAnalytics(const nlohmann::json &message)
+    {
+        if (!message.contains("Replicas") || !message.at("Replicas").is_array())
+        {
+            throw std::runtime_error("Invalid or missing 'Replicas' key in Init Analytics message");
+        }
+
+        std::vector<std::string> replicas = message.at("Replicas");
+        std::string replicaList;
+        for (const auto &replica : replicas)
+        {
+            replicaList += replica + " ";
+        }
+        logInfo("Init Analytics received. Replicas: ", replicaList);
+    }
+
+    void handleAnalytics(const nlohmann::json &message)
+    {
+        int requestId = message.at("requestID");
+        const nlohmann::json &rows = message.at("Data");
+        logInfo("Analytics request received with ID: ", requestId);
+
+        // A retried request is acknowledged again without re-ingesting; one
+        // that arrives while the first attempt is still ingesting is dropped,
+        // as that attempt will send the acknowledgment
+        uint64_t requestKey = RecentRequests::key(static_cast<uint8_t>(RequestType::Analytics), requestId);
+        uint64_t fingerprint = payloadFingerprint(rows);
+        nlohmann::json acknowledgment;
+        switch (recentRequests.begin(requestKey, fingerprint, acknowledgment))
+        {
+        case RecentRequests::Status::Answered:
+            serverMetrics().duplicateRequests.inc();
+            logInfo("Duplicate analytics request ", requestId, ", re-sending acknowledgment");
+            server->sendAcknowledgment(acknowledgment);
+            return;
+        case RecentRequests::Status::InProgress:
+            serverMetrics().duplicateRequests.inc();
+            logInfo("Duplicate analytics request ", requestId, " is still being ingested");
+            return;
+        case RecentRequests::Status::New:
+            break;
+        }
+
+        // Process the data
+        std::vector<std::vector<std::string>> data;
+        IngestResult ingested;
+        try
+        {
+            data = rows.get<std::vector<std::vector<std::string>>>();
+            ScopedTimer timer(serverMetrics().ingestSeconds);
+            ingested = store.ingest(data);
+        }
+        catch (...)
+        {
+            recentRequests.abandon(requestKey, fingerprint);
+            throw;
+        }
+        recordIngest(ingested);
+        serverMetrics().storedRows.set(static_cast<int64_t>(store.size()));
+        if (ingested.malformed + ingested.rejected > 0)
+        {
+            logWarn("Analytics request ", requestId, ": ", ingested.malformed, " malformed rows skipped, ",
+                    ingested.rejected, " rows rejected (string dictionary full)");
+        }
+
+        if (logger().enabled(LogLevel::Debug))
+        {
+            for (const auto &item : data)
+            {
+                if (!rowLogLimiter.allow())
+                {
+                    break;
+                }
+                std::string row;
+                for (const auto &value : item)
+                {
+                    row += value + " ";
+                }
+                logDebug("Data: ", row);
+            }
+        }
+
+        // Send acknowledgment
+        acknowledgment = {
+            {"requestType", "analytics acknowledgment"},
+            {"requestID", requestId}};
+        if (ingested.malformed + ingested.rejected > 0)
+        {
+            acknowledgment["rejected"] = ingested.malformed + ingested.rejected;
+        }
+        recentRequests.complete(requestKey, fingerprint, acknowledgment);
+        server->sendAcknowledgment(acknowledgment);
+    }
+
+    void handleBulkLoad(const nlohmann::json &message)
+    {
+        int requestId = message.at("requestID");
+        std::string path = message.at("path");
+        logInfo("Bulk load request received with ID: ", requestId, " path: ", path);
+        path = resolveDataPath(server->config().dataDir, path);
+
+        // Parse the server-local file in parallel and append in large batches
+        std::atomic<size_t> stored{0};
+        std::atomic<size_t> duplicates{0};
+        std::atomic<size_t> rejected{0};
+        BulkLoadResult loaded = loadRowsParallel(path, 50000, std::thread::hardware_concurrency(), [&](std::vector<std::vector<std::string>> &batch)
+                                                 {
+            IngestResult ingested = store.ingest(batch);
+            recordIngest(ingested);
+            stored += ingested.stored;
+            duplicates += ingested.duplicates;
+            rejected += ingested.malformed + ingested.rejected; });
+        serverMetrics().storedRows.set(static_cast<int64_t>(store.size()));
+        logInfo("Bulk loaded ", stored.load(), " of ", loaded.rows, " rows from ", path, " (", loaded.skippedLines, " lines skipped, ",
+                duplicates.load(), " duplicate rows, ", rejected.load(), " rows rejected)");
+
+        nlohmann::json acknowledgment = {
+            {"requestType", "analytics acknowledgment"},
+            {"requestID", requestId},
+            {"rows", loaded.rows},
+            {"stored", stored.load()},
+            {"duplicates", duplicates.load()},
+            {"rejected", rejected.load()}};
+        server->sendAcknowledgment(acknowledgment);
+    }
+
+    void handleQuery(const nlohmann::json &message)
+    {
+        int requestId = message.at("requestID");
+        int queryType = message.at("query");
+        logInfo("Query request received with ID: ", requestId, " and query type: ", queryType);
+
+        // Identical query specs (including retries) are served from the cache until the next ingest
+        nlohmann::json querySpec = message;
+        querySpec.erase("requestID");
+        std::string cacheKey = querySpec.dump();
+        uint64_t version = store.version();
+        nlohmann::json queryResult;
+        if (queryCache.lookup(cacheKey, version, queryResult))
+        {
+            serverMetrics().queryCacheHits.inc();
+        }
+        else
+        {
+            serverMetrics().queryCacheMisses.inc();
+            ScopedTimer timer(serverMetrics().querySeconds);
+            queryResult = evaluateQuery(store, message);
+            queryCache.insert(cacheKey, version, queryResult);
+        }
+
+        // Send query response
+        nlohmann::json queryResponse = {
+            {"requestType", "query response"},
+            {"requestID", requestId}};
+        queryResponse.update(queryResult);
+        server->sendQueryResponse(queryResponse);
+
+        logInfo("Sent query response with request ID: ", requestId, " result: ", queryResult.dump());
+    }
+
+    // Identifies the payload of an "analytics" request by its rows as parsed,
+    // so re-serializing it with different whitespace does not change it.
+    static uint64_t payloadFingerprint(const nlohmann::json &rows)
+    {
+        return stableHash64(rows.dump());
+    }
+
+    static void recordIngest(const IngestResult &ingested)
+    {
+        serverMetrics().ingestedRows.inc(ingested.stored);
+        serverMetrics().duplicateRows.inc(ingested.duplicates);
+        serverMetrics().malformedRows.inc(ingested.malformed);
+        serverMetrics().dictionaryFullRows.inc(ingested.rejected);
+    }
+
+    ServerCore *server = nullptr;
+    AnalyticsStore store;           // To store ingested data
+    QueryCache queryCache;
+    RecentRequests recentRequests;  // Acknowledgments of recent ingest requests, for retries
+    RateLimiter rowLogLimiter{100}; // Per-row debug lines per second
+};
@@ -0,0 +1,526 @@
+#pragma once
+
+// In-memory store of ingested AQI rows and the queries evaluated over it.
+//
+// Rows arrive in the 13-field AirNow-style layout sent by the ingestion client:
+//   [0] timestamp  [1] latitude  [2] longitude  [3] parameter  [4] value
+//   [5] unit  [6] raw concentration  [7] AQI  [8] category  [9] area
+//   [10] agency  [11] site ID  [12] full AQS ID
+// and are stored as compact AqiRow records: the timestamp is parsed into minutes
+// since the Unix epoch, the low-cardinality strings (parameter, unit, area,
+// agency, site) are interned into the global dictionaries, and numeric fields
+// are parsed once at ingest.
+//
+// Rows are partitioned by pollutant parameter (PM2.5, O3, ...): each partition
+// holds its own rows, per-area sketches and grid index, so a query filtered by
+// pollutant scans only that partition. Unfiltered queries span all partitions.
+//
+// Ingest takes an exclusive lock and queries a shared one, so concurrent
+// handler threads can read while no batch is being appended.
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dedup_index.hpp"
+#include "geo_index.hpp"
+#include "group_by.hpp"
+#include "sketches.hpp"
+#include "string_dictionary.hpp"
+
+struct AqiRow
+{
+    uint32_t timestamp; // Minutes since the Unix epoch
+    uint32_t parameter; // Dictionary IDs
+    uint32_t unit;
+    uint32_t area;
+    uint32_t agency;
+    uint32_t site;
+    uint32_t aqsId;
+    float latitude;
+    float longitude;
+    double value;
+    float rawConcentration;
+    int32_t aqi;
+    int32_t category;
+};
+
+// Per-area sketches maintained at ingest: AQI value quantiles and distinct sites.
+struct AreaSketches
+{
+    TDigest values;
+    HyperLogLog sites;
+};
+
+struct AreaAggregate
+{
+    std::string area;
+    GroupAccumulator totals;
+    double value = 0.0; // Ranking value: average or max of the area
+};
+
+struct GeoQueryResult
+{
+    GroupAccumulator totals;
+    std::string maxArea;
+    std::string maxSite;
+    double maxLatitude = 0.0;
+    double maxLongitude = 0.0;
+    std::vector<std::pair<uint64_t, GroupAccumulator>> cells; // Grid cell key and aggregate
+};
+
+struct IngestResult
+{
+    size_t stored = 0;
+    size_t duplicates = 0; // Same site, timestamp and parameter as a stored row
+    size_t malformed = 0;  // Fewer than 13 fields, a bad timestamp, or a non-finite coordinate or value
+    size_t rejected = 0;   // A string dictionary is full
+};
+
+struct QueryResult
+{
+    std::string maxArea;
+    double maxValue = 0.0;
+};
+
+class AnalyticsStore
+{
+public:
+    using Row = std::vector<std::string>;
+
+    // Converts and appends `rows`. Rows without all 13 fields, with a bad
+    // timestamp, or with a coordinate or value that is not a finite number
+    // are skipped, as are re-sent readings: a row whose (site ID, timestamp,
+    // parameter) was already stored is dropped, so replayed batches are
+    // idempotent. Rows needing a new string once a dictionary is full are
+    // rejected; the rest of the batch is still stored.
+    IngestResult ingest(const std::vector<Row> &rows)
+    {
+        IngestResult result;
+        std::vector<AqiRow> converted;
+        converted.reserve(rows.size());
+        for (const auto &row : rows)
+        {
+            AqiRow item;
+            switch (row.size() >= 13 ? toAqiRow(row, item) : Conversion::Malformed)
+            {
+            case Conversion::Converted:
+                converted.push_back(item);
+                break;
+            case Conversion::Malformed:
+                ++result.malformed;
+                break;
+            case Conversion::DictionaryFull:
+                ++result.rejected;
+                break;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        for (const auto &row : converted)
+        {
+            Partition &target = partition(row.parameter);
+            if (!target.readings.insert(static_cast<uint64_t>(row.site) << 32 | row.timestamp))
+            {
+                ++result.duplicates;
+                continue;
+            }
+            target.append(row, siteHash(row.site));
+            ++result.stored;
+        }
+        rowCount += result.stored;
+        if (result.stored > 0)
+        {
+            dataVersion.fetch_add(1, std::memory_order_release);
+        }
+        return result;
+    }
+
+    // Incremented by every ingest that stores rows; keys the query cache.
+    uint64_t version() const { return dataVersion.load(std::memory_order_acquire); }
+
+    size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return rowCount;
+    }
+
+    // Rows held for one pollutant parameter.
+    size_t size(const std::string &pollutant) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        size_t rows = 0;
+        forEachPartition(pollutant, [&](const Partition &partition)
+                         { rows += partition.rows.size(); });
+        return rows;
+    }
+
+    // An empty `pollutant` in the queries below means all pollutants.
+    QueryResult query(int queryType, const std::string &pollutant = "") const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        QueryResult result;
+        if (queryType != 0 && queryType != 1)
+        {
+            return result;
+        }
+
+        // QUERY 0: Maximum of the averages AQI over all areas and all timelines
+        // QUERY 1: Maximum of the maximum AQIs over all time over all the areas
+        uint32_t maxAreaId = StringDictionary::npos;
+        aggregateByArea(pollutant).forEach([&](uint32_t area, const GroupAccumulator &totals)
+                                           {
+            double value = queryType == 0 ? totals.average() : totals.max;
+            if (value > result.maxValue)
+            {
+                result.maxValue = value;
+                maxAreaId = area;
+            } });
+
+        if (maxAreaId != StringDictionary::npos)
+        {
+            result.maxArea = dictionaries().areas.lookup(maxAreaId);
+        }
+        return result;
+    }
+
+    // The `k` areas with the highest average (or max) value, highest first.
+    // Selection keeps a bounded min-heap of k entries over the per-area
+    // aggregates instead of sorting every area.
+    std::vector<AreaAggregate> topAreas(size_t k, bool byAverage, const std::string &pollutant = "") const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        DenseGroupBy areaGroups = aggregateByArea(pollutant);
+
+        using Entry = std::pair<double, uint32_t>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        areaGroups.forEach([&](uint32_t area, const GroupAccumulator &totals)
+                           {
+            double value = byAverage ? totals.average() : totals.max;
+            if (heap.size() < k)
+            {
+                heap.emplace(value, area);
+            }
+            else if (k > 0 && value > heap.top().first)
+            {
+                heap.pop();
+                heap.emplace(value, area);
+            } });
+
+        std::vector<AreaAggregate> result(heap.size());
+        for (size_t i = result.size(); i-- > 0;)
+        {
+            auto [value, area] = heap.top();
+            heap.pop();
+            result[i].area = dictionaries().areas.lookup(area);
+            result[i].totals = areaGroups[area];
+            result[i].value = value;
+        }
+        return result;
+    }
+
+    // Aggregate of the rows located inside `region`, the location of its max
+    // value and, when `perCell` is set, the aggregate of each grid cell.
+    GeoQueryResult geoQuery(const GeoRegion &region, bool perCell, const std::string &pollutant = "") const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        GeoQueryResult result;
+        const AqiRow *maxRow = nullptr;
+        FlatGroupBy cells;
+
+        forEachPartition(pollutant, [&](const Partition &partition)
+                         { partition.geoIndex.forEachCell(region, [&](uint64_t key, const GeoGridIndex::Cell &cell, bool fullyInside)
+                                                          {
+            GroupAccumulator cellTotals;
+            if (fullyInside)
+            {
+                cellTotals = cell.totals;
+                if (cell.totals.max > result.totals.max)
+                {
+                    maxRow = &partition.rows[cell.maxRow];
+                }
+            }
+            else
+            {
+                for (uint32_t row : cell.rows)
+                {
+                    const AqiRow &item = partition.rows[row];
+                    if (region.contains(item.latitude, item.longitude))
+                    {
+                        if (item.value > std::max(cellTotals.max, result.totals.max))
+                        {
+                            maxRow = &item;
+                        }
+                        cellTotals.add(item.value);
+                    }
+                }
+            }
+            if (cellTotals.count > 0)
+            {
+                result.totals.merge(cellTotals);
+                if (perCell)
+                {
+                    cells[key].merge(cellTotals);
+                }
+            } }); });
+
+        cells.forEach([&](uint64_t key, const GroupAccumulator &totals)
+                      { result.cells.emplace_back(key, totals); });
+        if (maxRow != nullptr)
+        {
+            result.maxArea = dictionaries().areas.lookup(maxRow->area);
+            result.maxSite = dictionaries().sites.lookup(maxRow->site);
+            result.maxLatitude = maxRow->latitude;
+            result.maxLongitude = maxRow->longitude;
+        }
+        return result;
+    }
+
+    // Visits (area name, sketches) for every area with data, or only `area` when
+    // it is non-empty, while holding the read lock. Across several pollutants
+    // the per-partition sketches of an area are merged first.
+    template <typename Visitor>
+    void forEachAreaSketch(const std::string &area, Visitor visitor, const std::string &pollutant = "") const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        StringDictionary &areas = dictionaries().areas;
+        std::vector<const Partition *> selected;
+        forEachPartition(pollutant, [&](const Partition &partition)
+                         { selected.push_back(&partition); });
+
+        auto visitArea = [&](uint32_t id)
+        {
+            const AreaSketches *single = nullptr;
+            std::unique_ptr<AreaSketches> merged;
+            for (const Partition *partition : selected)
+            {
+                if (id >= partition->areaSketches.size() || !partition->areaSketches[id])
+                {
+                    continue;
+                }
+                const AreaSketches &sketches = *partition->areaSketches[id];
+                if (single == nullptr)
+                {
+                    single = &sketches;
+                    continue;
+                }
+                if (!merged)
+                {
+                    merged = std::make_unique<AreaSketches>(*single);
+                }
+                merged->values.merge(sketches.values);
+                merged->sites.merge(sketches.sites);
+            }
+            if (single != nullptr)
+            {
+                visitor(areas.lookup(id), merged ? *merged : *single);
+            }
+        };
+
+        if (!area.empty())
+        {
+            uint32_t id = areas.find(area);
+            if (id != StringDictionary::npos)
+            {
+                visitArea(id);
+            }
+            return;
+        }
+        uint32_t areaCount = areas.size();
+        for (uint32_t id = 0; id < areaCount; ++id)
+        {
+            visitArea(id);
+        }
+    }
+
+private:
+    // Rows, sketches and grid index of one pollutant parameter.
+    struct Partition
+    {
+        std::vector<AqiRow> rows;
+        std::vector<std::unique_ptr<AreaSketches>> areaSketches; // Indexed by area ID
+        GeoGridIndex geoIndex;
+        DedupIndex readings; // (site ID << 32 | epoch minutes) of stored rows
+
+        void append(const AqiRow &row, uint64_t siteHash)
+        {
+            geoIndex.add(static_cast<uint32_t>(rows.size()), row.latitude, row.longitude, row.value);
+            rows.push_back(row);
+
+            if (row.area >= areaSketches.size())
+            {
+                areaSketches.resize(row.area + 1);
+            }
+            std::unique_ptr<AreaSketches> &sketches = areaSketches[row.area];
+            if (!sketches)
+            {
+                sketches = std::make_unique<AreaSketches>();
+            }
+            sketches->values.add(row.value);
+            sketches->sites.addHash(siteHash);
+        }
+    };
+
+    // Caller holds the exclusive lock.
+    Partition &partition(uint32_t parameter)
+    {
+        if (parameter >= partitions.size())
+        {
+            partitions.resize(parameter + 1);
+        }
+        if (!partitions[parameter])
+        {
+            partitions[parameter] = std::make_unique<Partition>();
+        }
+        return *partitions[parameter];
+    }
+
+    // Visits the partition of `pollutant`, or every partition when it is empty.
+    // Caller holds the lock.
+    template <typename Visitor>
+    void forEachPartition(const std::string &pollutant, Visitor visitor) const
+    {
+        if (pollutant.empty())
+        {
+            for (const auto &partition : partitions)
+            {
+                if (partition)
+                {
+                    visitor(*partition);
+                }
+            }
+            return;
+        }
+        uint32_t parameter = dictionaries().parameters.find(pollutant);
+        if (parameter < partitions.size() && partitions[parameter])
+        {
+            visitor(*partitions[parameter]);
+        }
+    }
+
+    // Stable hash of a site ID string, memoized per interned ID.
+    uint64_t siteHash(uint32_t site)
+    {
+        while (siteHashes.size() <= site)
+        {
+            siteHashes.push_back(stableHash64(dictionaries().sites.lookup(static_cast<uint32_t>(siteHashes.size()))));
+        }
+        return siteHashes[site];
+    }
+
+    // Sum, count and max of the value column per area ID. Caller holds the lock.
+    DenseGroupBy aggregateByArea(const std::string &pollutant) const
+    {
+        DenseGroupBy areaGroups(dictionaries().areas.size());
+        forEachPartition(pollutant, [&](const Partition &partition)
+                         {
+            for (const auto &item : partition.rows)
+            {
+                areaGroups.add(item.area, item.value);
+            } });
+        return areaGroups;
+    }
+
+    enum class Conversion
+    {
+        Converted,
+        Malformed,
+        DictionaryFull
+    };
+
+    // Parses "YYYY-MM-DDTHH:MM" into minutes since the Unix epoch. Anything
+    // after the minutes (seconds, a zone, an "@N" sequence suffix) is ignored.
+    // A day past the end of its month (such as February 30) is rejected, as it
+    // would otherwise alias a real date in the following month.
+    static bool parseTimestamp(const std::string &text, uint32_t &minutes)
+    {
+        auto number = [&](size_t at, size_t digits, int &value)
+        {
+            value = 0;
+            for (size_t i = at; i < at + digits; ++i)
+            {
+                if (text[i] < '0' || text[i] > '9')
+                {
+                    return false;
+                }
+                value = value * 10 + (text[i] - '0');
+            }
+            return true;
+        };
+        int year, month, day, hour, minute;
+        if (text.size() < 16 || text[4] != '-' || text[7] != '-' || text[10] != 'T' || text[13] != ':' ||
+            !number(0, 4, year) || !number(5, 2, month) || !number(8, 2, day) || !number(11, 2, hour) || !number(14, 2, minute) ||
+            year < 1970 || month < 1 || month > 12 || day < 1 || hour > 23 || minute > 59)
+        {
+            return false;
+        }
+        static constexpr int monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leapYear = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+        if (day > monthDays[month - 1] + (month == 2 && leapYear ? 1 : 0))
+        {
+            return false;
+        }
+        // Days from 1970-01-01 in the proleptic Gregorian calendar
+        int shiftedYear = month <= 2 ? year - 1 : year;
+        int era = shiftedYear / 400;
+        int yearOfEra = shiftedYear - era * 400;
+        int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        int64_t days = static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+        minutes = static_cast<uint32_t>((days * 24 + hour) * 60 + minute);
+        return true;
+    }
+
+    static Conversion toAqiRow(const Row &row, AqiRow &converted)
+    {
+        if (!parseTimestamp(row[0], converted.timestamp))
+        {
+            return Conversion::Malformed;
+        }
+        StringDictionaries &dict = dictionaries();
+        converted.latitude = std::strtof(row[1].c_str(), nullptr);
+        converted.longitude = std::strtof(row[2].c_str(), nullptr);
+        if (!std::isfinite(converted.latitude) || !std::isfinite(converted.longitude))
+        {
+            return Conversion::Malformed;
+        }
+        // The value feeds every aggregate and sketch, so it must be a finite number in full
+        char *valueEnd = nullptr;
+        converted.value = std::strtod(row[4].c_str(), &valueEnd);
+        if (row[4].empty() || valueEnd != row[4].c_str() + row[4].size() || !std::isfinite(converted.value))
+        {
+            return Conversion::Malformed;
+        }
+        converted.parameter = dict.parameters.intern(row[3]);
+        converted.unit = dict.units.intern(row[5]);
+        converted.rawConcentration = std::strtof(row[6].c_str(), nullptr);
+        converted.aqi = static_cast<int32_t>(std::strtol(row[7].c_str(), nullptr, 10));
+        converted.category = static_cast<int32_t>(std::strtol(row[8].c_str(), nullptr, 10));
+        converted.area = dict.areas.intern(row[9]);
+        converted.agency = dict.agencies.intern(row[10]);
+        converted.site = dict.sites.intern(row[11]);
+        converted.aqsId = dict.sites.intern(row[12]);
+        for (uint32_t id : {converted.parameter, converted.unit, converted.area, converted.agency, converted.site, converted.aqsId})
+        {
+            if (id == StringDictionary::npos)
+            {
+                return Conversion::DictionaryFull;
+            }
+        }
+        return Conversion::Converted;
+    }
+
+    mutable std::shared_mutex mutex;
+    std::vector<std::unique_ptr<Partition>> partitions; // Indexed by parameter ID
+    std::vector<uint64_t> siteHashes;                   // Indexed by site ID
+    size_t rowCount = 0;
+    std::atomic<uint64_t> dataVersion{0};
+};
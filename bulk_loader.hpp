@@ -0,0 +1,360 @@
+#pragma once
+
+// Parallel bulk loading of AQI rows from CSV or JSONL files.
+//
+// The file is memory-mapped and split into one newline-aligned chunk per
+// worker thread; each worker parses its chunk independently and hands rows to
+// the sink in batches. CSV lines are the 13-column AirNow-style format (fields
+// optionally double-quoted); JSONL lines are JSON arrays of the same 13 fields.
+// Lines with the wrong field count, a value column that is not a finite
+// number (such as a header row) or bytes that are not UTF-8 are skipped and
+// counted.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "json.hpp"
+
+constexpr size_t aqiFieldCount = 13;
+
+// Resolves a client-supplied `path` relative to `dataDirectory`. Absolute
+// paths, ".." components and paths that leave the directory through a
+// symbolic link are rejected with std::runtime_error.
+inline std::string resolveDataPath(const std::string &dataDirectory, const std::string &path)
+{
+    namespace fs = std::filesystem;
+    fs::path requested(path);
+    if (path.empty() || requested.is_absolute() || requested.has_root_name())
+    {
+        throw std::runtime_error("Bulk load path must be relative to the data directory: " + path);
+    }
+    for (const auto &component : requested)
+    {
+        if (component == "..")
+        {
+            throw std::runtime_error("Bulk load path must not contain '..': " + path);
+        }
+    }
+    fs::path base = fs::canonical(dataDirectory);
+    fs::path resolved = fs::weakly_canonical(base / requested);
+    auto [baseEnd, resolvedEnd] = std::mismatch(base.begin(), base.end(), resolved.begin(), resolved.end());
+    if (baseEnd != base.end())
+    {
+        throw std::runtime_error("Bulk load path is outside the data directory: " + path);
+    }
+    return resolved.string();
+}
+
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0)
+        {
+            void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            ::madvise(mapped, length, MADV_SEQUENTIAL);
+            bytes = static_cast<const char *>(mapped);
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (bytes != nullptr)
+        {
+            ::munmap(const_cast<char *>(bytes), length);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+};
+
+inline bool isNumericField(const std::string &field)
+{
+    if (field.empty())
+    {
+        return false;
+    }
+    char *end = nullptr;
+    double value = std::strtod(field.c_str(), &end);
+    return end == field.c_str() + field.size() && std::isfinite(value);
+}
+
+// True if [begin, end) is well-formed UTF-8 (no overlong forms, surrogates or
+// code points above U+10FFFF), as the JSON serializer requires of strings.
+inline bool isValidUtf8(const char *begin, const char *end)
+{
+    const auto *cursor = reinterpret_cast<const unsigned char *>(begin);
+    const auto *last = reinterpret_cast<const unsigned char *>(end);
+    while (cursor < last)
+    {
+        unsigned char lead = *cursor;
+        if (lead < 0x80)
+        {
+            ++cursor;
+            continue;
+        }
+        size_t length;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF)
+        {
+            length = 2;
+        }
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            length = 3;
+            low = lead == 0xE0 ? 0xA0 : 0x80;
+            high = lead == 0xED ? 0x9F : 0xBF;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            length = 4;
+            low = lead == 0xF0 ? 0x90 : 0x80;
+            high = lead == 0xF4 ? 0x8F : 0xBF;
+        }
+        else
+        {
+            return false;
+        }
+        if (static_cast<size_t>(last - cursor) < length || cursor[1] < low || cursor[1] > high)
+        {
+            return false;
+        }
+        for (size_t i = 2; i < length; ++i)
+        {
+            if (cursor[i] < 0x80 || cursor[i] > 0xBF)
+            {
+                return false;
+            }
+        }
+        cursor += length;
+    }
+    return true;
+}
+
+// Lines that are not valid UTF-8 (such as Latin-1 area names) are rejected:
+// their strings could not be serialized into query responses.
+inline bool parseCsvLine(const char *begin, const char *end, std::vector<std::string> &row)
+{
+    row.clear();
+    if (!isValidUtf8(begin, end))
+    {
+        return false;
+    }
+    const char *cursor = begin;
+    while (true)
+    {
+        std::string field;
+        if (cursor < end && *cursor == '"')
+        {
+            ++cursor;
+            while (cursor < end)
+            {
+                if (*cursor == '"')
+                {
+                    if (cursor + 1 < end && cursor[1] == '"')
+                    {
+                        field += '"';
+                        cursor += 2;
+                        continue;
+                    }
+                    ++cursor;
+                    break;
+                }
+                field += *cursor++;
+            }
+            while (cursor < end && *cursor != ',')
+            {
+                ++cursor;
+            }
+        }
+        else
+        {
+            const char *fieldEnd = std::find(cursor, end, ',');
+            field.assign(cursor, fieldEnd);
+            cursor = fieldEnd;
+        }
+        row.push_back(std::move(field));
+        if (cursor >= end)
+        {
+            break;
+        }
+        ++cursor; // Skip the comma
+    }
+    return row.size() == aqiFieldCount && isNumericField(row[4]);
+}
+
+inline bool parseJsonLine(const char *begin, const char *end, std::vector<std::string> &row)
+{
+    nlohmann::json parsed = nlohmann::json::parse(begin, end, nullptr, false);
+    if (!parsed.is_array() || parsed.size() != aqiFieldCount)
+    {
+        return false;
+    }
+    row.clear();
+    for (const auto &field : parsed)
+    {
+        row.push_back(field.is_string() ? field.get<std::string>() : field.dump());
+    }
+    return isNumericField(row[4]);
+}
+
+struct BulkLoadResult
+{
+    size_t rows = 0;
+    size_t skippedLines = 0;
+};
+
+// Parses `path` with `threads` workers, calling `sink` (from worker threads,
+// concurrently) with batches of at most `batchSize` rows. If a worker or the
+// sink throws, that worker stops and the first exception is rethrown once all
+// workers have finished.
+inline BulkLoadResult loadRowsParallel(const std::string &path, size_t batchSize, size_t threads,
+                                       const std::function<void(std::vector<std::vector<std::string>> &)> &sink)
+{
+    MappedFile file(path);
+    auto endsWith = [&path](const std::string &suffix)
+    { return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0; };
+    bool jsonLines = endsWith(".jsonl") || endsWith(".json");
+    threads = std::max<size_t>(1, std::min(threads, file.size() / (1 << 20) + 1));
+    batchSize = std::max<size_t>(1, batchSize);
+
+    // Chunk boundaries: start at equal offsets, then advance each to the next line start
+    std::vector<const char *> boundaries(threads + 1);
+    const char *fileBegin = file.data();
+    const char *fileEnd = file.data() + file.size();
+    boundaries[0] = fileBegin;
+    boundaries[threads] = fileEnd;
+    for (size_t i = 1; i < threads; ++i)
+    {
+        const char *candidate = fileBegin + file.size() * i / threads;
+        const char *newline = std::find(std::max(candidate, boundaries[i - 1]), fileEnd, '\n');
+        boundaries[i] = newline == fileEnd ? fileEnd : newline + 1;
+    }
+
+    std::atomic<size_t> totalRows{0};
+    std::atomic<size_t> skippedLines{0};
+    std::exception_ptr failure; // First exception thrown by a worker or the sink
+    std::mutex failureMutex;
+    auto parseChunk = [&](size_t i)
+    {
+        std::vector<std::vector<std::string>> batch;
+        batch.reserve(batchSize);
+        std::vector<std::string> row;
+        size_t rows = 0;
+        size_t skipped = 0;
+        const char *cursor = boundaries[i];
+        const char *chunkEnd = boundaries[i + 1];
+        while (cursor < chunkEnd)
+        {
+            const char *lineEnd = std::find(cursor, chunkEnd, '\n');
+            const char *contentEnd = lineEnd;
+            if (contentEnd > cursor && contentEnd[-1] == '\r')
+            {
+                --contentEnd;
+            }
+            if (contentEnd > cursor)
+            {
+                bool parsed = jsonLines ? parseJsonLine(cursor, contentEnd, row) : parseCsvLine(cursor, contentEnd, row);
+                if (parsed)
+                {
+                    batch.push_back(std::move(row));
+                    row = std::vector<std::string>();
+                    ++rows;
+                    if (batch.size() == batchSize)
+                    {
+                        sink(batch);
+                        batch.clear();
+                    }
+                }
+                else
+                {
+                    ++skipped;
+                }
+            }
+            if (lineEnd == chunkEnd)
+            {
+                break;
+            }
+            cursor = lineEnd + 1;
+        }
+        if (!batch.empty())
+        {
+            sink(batch);
+        }
+        totalRows += rows;
+        skippedLines += skipped;
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&, i]()
+                             {
+            try
+            {
+                parseChunk(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(failureMutex);
+                if (!failure)
+                {
+                    failure = std::current_exception();
+                }
+            } });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+
+    BulkLoadResult result;
+    result.rows = totalRows;
+    result.skippedLines = skippedLines;
+    return result;
+}
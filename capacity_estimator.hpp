@@ -0,0 +1,137 @@
+#pragma once
+
+// Measured computingCapacity of a node, in [0, 1].
+//
+// sample() is called before every heartbeat but only re-measures once per
+// window (10 s by default), so a 150 ms heartbeat does not report noise. Each
+// measurement multiplies three headroom factors over the window:
+//   - CPU: the share of all cores not used by this process (its CPU time, so
+//     other processes on the machine do not move it);
+//   - queue depth: connections being handled, averaged over every sample() in
+//     the window, against a budget of two per core;
+//   - latency: mean ingest/query latency against a target, falling off as it
+//     grows past it.
+// The product is smoothed across windows, and the reported value only moves
+// (in steps of 0.05) once the smoothed one is 0.2 away from it. Each move is a
+// journaled registry write pushed to every subscriber, so it should be rare.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "metrics.hpp"
+
+class CapacityEstimator
+{
+public:
+    CapacityEstimator(const Gauge &activeConnections, std::vector<const Histogram *> latencies, double latencyTargetSeconds = 0.05,
+                      std::chrono::steady_clock::duration window = std::chrono::seconds(10))
+        : activeConnections(activeConnections), latencies(std::move(latencies)), latencyTarget(latencyTargetSeconds), window(window),
+          cores(std::max(1u, std::thread::hardware_concurrency())), connectionBudget(2.0 * cores),
+          windowStart(std::chrono::steady_clock::now()), lastCpuSeconds(processCpuSeconds())
+    {
+        for (const Histogram *histogram : this->latencies)
+        {
+            lastCount += histogram->totalCount();
+            lastSum += histogram->sum();
+        }
+    }
+
+    // Not thread-safe; called from the heartbeat thread only.
+    double sample()
+    {
+        depthSum += static_cast<double>(std::max<int64_t>(activeConnections.get(), 0));
+        ++depthSamples;
+        auto now = std::chrono::steady_clock::now();
+        bool windowEnded = now - windowStart >= window;
+        if (reported >= 0 && !windowEnded)
+        {
+            return reported;
+        }
+
+        // The value sent at registration has no CPU window behind it yet
+        double capacity = windowEnded ? cpuHeadroom(std::chrono::duration<double>(now - windowStart).count()) : 1.0;
+        capacity *= queueHeadroom() * latencyHeadroom();
+        if (windowEnded)
+        {
+            windowStart = now;
+        }
+        smoothed = smoothed < 0 ? capacity : 0.5 * smoothed + 0.5 * capacity;
+        if (reported < 0 || std::abs(smoothed - reported) >= 0.2)
+        {
+            reported = std::clamp(std::round(smoothed * 20) / 20, 0.0, 1.0);
+        }
+        return reported;
+    }
+
+private:
+    double cpuHeadroom(double elapsedSeconds)
+    {
+        double cpuSeconds = processCpuSeconds();
+        double used = cpuSeconds - lastCpuSeconds;
+        lastCpuSeconds = cpuSeconds;
+        if (elapsedSeconds <= 0 || used < 0)
+        {
+            return 1.0;
+        }
+        return std::clamp(1.0 - used / (elapsedSeconds * cores), 0.0, 1.0);
+    }
+
+    double queueHeadroom()
+    {
+        double depth = depthSum / static_cast<double>(depthSamples);
+        depthSum = 0;
+        depthSamples = 0;
+        return std::max(0.0, 1.0 - depth / connectionBudget);
+    }
+
+    double latencyHeadroom()
+    {
+        uint64_t count = 0;
+        double sum = 0;
+        for (const Histogram *histogram : latencies)
+        {
+            count += histogram->totalCount();
+            sum += histogram->sum();
+        }
+        double factor = 1.0;
+        if (count > lastCount)
+        {
+            double mean = (sum - lastSum) / static_cast<double>(count - lastCount);
+            factor = mean <= latencyTarget ? 1.0 : latencyTarget / mean;
+        }
+        lastCount = count;
+        lastSum = sum;
+        return factor;
+    }
+
+    // CPU time used by all threads of this process.
+    static double processCpuSeconds()
+    {
+        timespec time{};
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+        {
+            return 0;
+        }
+        return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) / 1e9;
+    }
+
+    const Gauge &activeConnections;
+    const std::vector<const Histogram *> latencies;
+    const double latencyTarget;
+    const std::chrono::steady_clock::duration window;
+    const unsigned cores;
+    const double connectionBudget;
+    std::chrono::steady_clock::time_point windowStart;
+    double lastCpuSeconds = 0;
+    double depthSum = 0;
+    uint64_t depthSamples = 0;
+    uint64_t lastCount = 0;
+    double lastSum = 0;
+    double smoothed = -1;
+    double reported = -1;
+};
@@ -1,16 +1,379 @@
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
 #include <vector>
 #include <thread>
+#include <string>
 #include <asio.hpp>
 #include "json.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "node_table.hpp"
+#include "registry_journal.hpp"
+#include "request_type.hpp"
+#include "server_config.hpp"
+#include "timer_wheel.hpp"
 
 using json = nlohmann::json;
 using asio::ip::tcp;
 
-std::vector<json> registeredNodes;
+// A node stays listed while it keeps renewing its lease with heartbeats.
+constexpr std::chrono::seconds leaseDuration(10);
+
+// Registrations, heartbeats and expiry take it exclusively; snapshots,
+// lookups and subscriber updates share it.
+std::shared_mutex registryMutex;
+NodeTable registeredNodes;
+TimerWheel<std::string> leaseTimers(std::chrono::milliseconds(250));
+
+// Membership is versioned: every add/update/remove bumps membershipVersion and
+// is kept in a bounded change log, from which subscribers are sent deltas.
+// Versions are only comparable within one registry epoch; the epoch and
+// version survive restarts through the journal.
+constexpr size_t changeLogCapacity = 1024;
+uint64_t registryEpoch = std::random_device()() ^ static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+uint64_t membershipVersion = 0;
+std::deque<json> changeLog; // {"version", "op", "node"}, oldest first
+std::condition_variable_any membershipChanged;
+// A subscriber that has had no update for this long is sent an empty line, so
+// that a disconnected one is found (by the failed write) and its thread freed
+// without waiting for the next membership change.
+constexpr std::chrono::seconds subscriberKeepalive(15);
+std::unique_ptr<RegistryJournal> journal; // Persists every change
+
+// Leadership is a short lease held by one node of the role's type and renewed
+// by that node's heartbeats (metadata nodes heartbeat every 150 ms), so a
+// failed leader is replaced within about leaderLeaseDuration.
+constexpr std::chrono::milliseconds leaderLeaseDuration(500);
+
+struct LeaderRole
+{
+    const char *name;     // Field name in Node Discovery
+    const char *nodeType; // Nodes eligible for the role
+    std::string ip;       // Current leader, "" if none
+    uint64_t term = 0;
+    std::chrono::steady_clock::time_point expiresAt;
+};
+
+LeaderRole leaderRoles[] = {
+    {"metadataAnalyticsLeader", "metadata Analytics", "", 0, {}},
+    {"metadataIngestionLeader", "metadata Ingestion", "", 0, {}}};
+
+struct RegistryMetrics
+{
+    Counter &registeringMessages = metrics().counter("registry_messages_total", "Messages received by request type.", {{"requestType", "registering"}});
+    Counter &heartbeatMessages = metrics().counter("registry_messages_total", "Messages received by request type.", {{"requestType", "heartbeat"}});
+    Counter &lookupMessages = metrics().counter("registry_messages_total", "Messages received by request type.", {{"requestType", "lookup"}});
+    Counter &subscribeMessages = metrics().counter("registry_messages_total", "Messages received by request type.", {{"requestType", "subscribe"}});
+    Counter &invalidMessages = metrics().counter("registry_messages_total", "Messages received by request type.", {{"requestType", "invalid"}});
+    Counter &elections = metrics().counter("registry_leader_elections_total", "Leader changes, including a role becoming vacant.");
+    Counter &expiredNodes = metrics().counter("registry_expired_nodes_total", "Nodes removed because their lease expired.");
+    Counter &bytesIn = metrics().counter("registry_bytes_in_total", "Bytes of request messages received.");
+    Counter &bytesOut = metrics().counter("registry_bytes_out_total", "Bytes of Node Discovery messages sent.");
+    Gauge &registeredNodeCount = metrics().gauge("registry_registered_nodes", "Nodes currently in the membership table.");
+    Gauge &activeConnections = metrics().gauge("registry_active_connections", "Client connections currently being handled (queue depth).");
+    Gauge &subscribers = metrics().gauge("registry_subscribers", "Nodes subscribed to membership updates.");
+    Gauge &version = metrics().gauge("registry_membership_version", "Current membership version.");
+    Histogram &parseSeconds = metrics().histogram("registry_parse_seconds", "Time spent parsing request JSON.");
+    Histogram &discoverySendSeconds = metrics().histogram("registry_discovery_send_seconds", "Time spent building and sending Node Discovery messages.");
+};
+
+RegistryMetrics &registryMetrics()
+{
+    static RegistryMetrics instance;
+    return instance;
+}
+
+// Records a membership change ({"op", ...}) and wakes the subscribers. Caller
+// holds registryMutex.
+void recordChange(json change)
+{
+    change["version"] = ++membershipVersion;
+    if (journal)
+    {
+        journal->append(change);
+    }
+    changeLog.push_back(std::move(change));
+    if (changeLog.size() > changeLogCapacity)
+    {
+        changeLog.pop_front();
+    }
+    registryMetrics().version.set(static_cast<int64_t>(membershipVersion));
+    membershipChanged.notify_all();
+}
+
+// Elects `role` among its live candidates, bully-style: the highest
+// (computingCapacity, Ip) wins. A candidate counts as live if it heartbeated
+// within the leader lease. Each new leader gets the next term, which nodes use
+// to tell a stale leader from the current one. Caller holds registryMutex.
+void electLeader(LeaderRole &role, std::chrono::steady_clock::time_point now)
+{
+    std::string winner;
+    for (const NodeRecord *candidate : registeredNodes.topByCapacity(role.nodeType, registeredNodes.size()))
+    {
+        if (candidate->expiresAt - leaseDuration + leaderLeaseDuration > now)
+        {
+            winner = candidate->ip;
+            break;
+        }
+    }
+    if (winner.empty() && role.ip.empty())
+    {
+        return;
+    }
+    role.ip = winner;
+    role.expiresAt = now + leaderLeaseDuration;
+    if (!winner.empty())
+    {
+        ++role.term;
+    }
+    logInfo("Elected ", role.name, ": ", winner.empty() ? "none" : winner, " (term ", role.term, ")");
+    registryMetrics().elections.inc();
+    recordChange({{"op", "leader"}, {"role", role.name}, {"Ip", role.ip}, {"term", role.term}});
+}
+
+// Adds or refreshes `node` and renews its lease.
+NodeTable::Upsert renewLease(NodeRecord node)
+{
+    auto now = std::chrono::steady_clock::now();
+    node.expiresAt = now + leaseDuration;
+    std::unique_lock<std::shared_mutex> lock(registryMutex);
+    NodeTable::Upsert result = registeredNodes.upsert(node);
+    if (result != NodeTable::Upsert::Renewed)
+    {
+        recordChange({{"op", result == NodeTable::Upsert::Added ? "added" : "updated"}, {"node", node.toJson()}});
+    }
+    for (auto &role : leaderRoles)
+    {
+        if (role.ip == node.ip)
+        {
+            role.expiresAt = now + leaderLeaseDuration; // The leader's heartbeat renews its leadership
+        }
+        else if (role.ip.empty() && node.nodeType == role.nodeType)
+        {
+            electLeader(role, now);
+        }
+    }
+    leaseTimers.schedule(node.ip, node.expiresAt);
+    registryMetrics().registeredNodeCount.set(static_cast<int64_t>(registeredNodes.size()));
+    return result;
+}
+
+// Full "Node Discovery" snapshot. Caller holds registryMutex.
+json discoverySnapshot()
+{
+    json nodes = json::array();
+    registeredNodes.forEach([&](const NodeRecord &node)
+                            { nodes.push_back(node.toJson()); });
+    json snapshot = {
+        {"requestType", "Node Discovery"},
+        {"epoch", registryEpoch},
+        {"version", membershipVersion},
+        {"nodes", nodes}};
+    json terms = json::object();
+    for (const auto &role : leaderRoles)
+    {
+        snapshot[role.name] = role.ip;
+        terms[role.name] = role.term;
+    }
+    snapshot["leaderTerms"] = terms;
+    // Elections are run by the registry; the ingestion leader is reported here
+    // for nodes that still read this field
+    snapshot["initElectionIngestion"] = leaderRoles[1].ip;
+    return snapshot;
+}
+
+// What a node at `knownVersion` of `knownEpoch` is missing: the changes since
+// then, or a snapshot if they have left the change log or the node's version
+// is from another epoch. Caller holds registryMutex.
+json discoveryUpdateSince(uint64_t knownEpoch, uint64_t knownVersion)
+{
+    uint64_t oldestLogged = changeLog.empty() ? membershipVersion + 1 : changeLog.front()["version"].get<uint64_t>();
+    if (knownEpoch != registryEpoch || knownVersion > membershipVersion || knownVersion + 1 < oldestLogged)
+    {
+        return discoverySnapshot();
+    }
+    json changes = json::array();
+    for (auto it = changeLog.end() - static_cast<std::ptrdiff_t>(membershipVersion - knownVersion); it != changeLog.end(); ++it)
+    {
+        changes.push_back(*it);
+    }
+    return {
+        {"requestType", "Node Discovery Delta"},
+        {"epoch", registryEpoch},
+        {"fromVersion", knownVersion},
+        {"version", membershipVersion},
+        {"changes", changes}};
+}
+
+// Streams membership updates to a subscribed node over its connection until
+// it goes away: first whatever it is missing, then each batch of changes, with
+// keepalive lines in between.
+void serveSubscriber(tcp::socket &socket, uint64_t knownEpoch, uint64_t knownVersion)
+{
+    registryMetrics().subscribers.add(1);
+    try
+    {
+        // Also detects peers that vanished without closing the connection
+        socket.set_option(asio::socket_base::keep_alive(true));
+        while (true)
+        {
+            std::string updateMessage = "\n";
+            {
+                std::shared_lock<std::shared_mutex> lock(registryMutex);
+                if (membershipChanged.wait_for(lock, subscriberKeepalive, [&]()
+                                               { return knownEpoch != registryEpoch || membershipVersion != knownVersion; }))
+                {
+                    updateMessage = discoveryUpdateSince(knownEpoch, knownVersion).dump() + "\n";
+                    knownEpoch = registryEpoch;
+                    knownVersion = membershipVersion;
+                }
+            }
+            asio::write(socket, asio::buffer(updateMessage));
+            registryMetrics().bytesOut.inc(updateMessage.size());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        logInfo("Membership subscriber disconnected: ", e.what());
+    }
+    registryMetrics().subscribers.add(-1);
+}
+
+// Drops nodes whose lease ran out, so they are no longer handed out for routing,
+// and replaces leaders whose leader lease ran out.
+void expireLeases()
+{
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto now = std::chrono::steady_clock::now();
+        std::unique_lock<std::shared_mutex> lock(registryMutex);
+        leaseTimers.advance(now, [&](const std::string &ip)
+                            {
+            const NodeRecord *node = registeredNodes.find(ip);
+            if (node == nullptr || node->expiresAt > now)
+            {
+                return; // Already gone, or renewed since this timer was set
+            }
+            json nodeInfo = node->toJson();
+            logWarn("Node lease expired: ", nodeInfo.dump());
+            recordChange({{"op", "removed"}, {"node", nodeInfo}});
+            registeredNodes.erase(ip);
+            registryMetrics().expiredNodes.inc(); });
+        for (auto &role : leaderRoles)
+        {
+            if (!role.ip.empty() && role.expiresAt <= now)
+            {
+                logWarn("Leader lease of ", role.name, " ", role.ip, " expired");
+                electLeader(role, now);
+            }
+        }
+        registryMetrics().registeredNodeCount.set(static_cast<int64_t>(registeredNodes.size()));
+    }
+}
+
+void handleRegistering(tcp::socket &socket, const json &request)
+{
+    NodeRecord node = NodeRecord::fromJson(request);
+    bool isNew = renewLease(node) == NodeTable::Upsert::Added;
+    logInfo(isNew ? "Node connected: " : "Node re-registered: ", node.toJson().dump());
+
+    ScopedTimer discoveryTimer(registryMetrics().discoverySendSeconds);
+    json discoveryMessage;
+    {
+        std::shared_lock<std::shared_mutex> lock(registryMutex);
+        discoveryMessage = discoverySnapshot();
+    }
+
+    std::string discoveryMessageStr = discoveryMessage.dump() + "\n";
+    asio::write(socket, asio::buffer(discoveryMessageStr));
+    registryMetrics().bytesOut.inc(discoveryMessageStr.size());
+}
+
+// A heartbeat from an unknown node (e.g. after a registry restart) re-admits it.
+void handleHeartbeat(tcp::socket &, const json &request)
+{
+    NodeRecord node = NodeRecord::fromJson(request);
+    if (renewLease(node) == NodeTable::Upsert::Added)
+    {
+        logInfo("Node connected by heartbeat: ", node.toJson().dump());
+    }
+}
+
+// {"Ip": ...} for one node, or {"nodeType": ..., "limit": k} for the k
+// highest-capacity nodes of that type.
+void handleLookup(tcp::socket &socket, const json &request)
+{
+    json nodes = json::array();
+    {
+        std::shared_lock<std::shared_mutex> lock(registryMutex);
+        if (request.contains("Ip"))
+        {
+            if (const NodeRecord *node = registeredNodes.find(request.at("Ip").get<std::string>()))
+            {
+                nodes.push_back(node->toJson());
+            }
+        }
+        else
+        {
+            size_t limit = request.value("limit", registeredNodes.size());
+            for (const NodeRecord *node : registeredNodes.topByCapacity(request.value("nodeType", "analytics"), limit))
+            {
+                nodes.push_back(node->toJson());
+            }
+        }
+    }
+    json lookupResponse = {{"requestType", "lookup response"}, {"nodes", nodes}};
+    std::string lookupResponseStr = lookupResponse.dump() + "\n";
+    asio::write(socket, asio::buffer(lookupResponseStr));
+    registryMetrics().bytesOut.inc(lookupResponseStr.size());
+}
+
+void handleSubscribe(tcp::socket &socket, const json &request)
+{
+    serveSubscriber(socket, request.value("epoch", uint64_t(0)), request.value("version", uint64_t(0)));
+}
+
+// Handlers of the registry's request types, resolved with the same RequestType
+// table as the nodes; types without a handler are counted as invalid.
+using RegistryHandler = void (*)(tcp::socket &socket, const json &request);
+
+struct RegistryRoute
+{
+    RegistryHandler handler = nullptr;
+    Counter *messages = nullptr;
+};
+
+std::array<RegistryRoute, requestTypeCount> buildRegistryRoutes()
+{
+    std::array<RegistryRoute, requestTypeCount> routes;
+    auto on = [&](RequestType type, RegistryHandler handler, Counter &messages)
+    {
+        routes[static_cast<size_t>(type)] = {handler, &messages};
+    };
+    on(RequestType::Registering, handleRegistering, registryMetrics().registeringMessages);
+    on(RequestType::Heartbeat, handleHeartbeat, registryMetrics().heartbeatMessages);
+    on(RequestType::Lookup, handleLookup, registryMetrics().lookupMessages);
+    on(RequestType::Subscribe, handleSubscribe, registryMetrics().subscribeMessages);
+    return routes;
+}
+
+const std::array<RegistryRoute, requestTypeCount> &registryRoutes()
+{
+    static const std::array<RegistryRoute, requestTypeCount> routes = buildRegistryRoutes();
+    return routes;
+}
 
 void handleClient(tcp::socket socket)
 {
+    registryMetrics().activeConnections.add(1);
     try
     {
         asio::streambuf buffer;
@@ -18,39 +381,161 @@ void handleClient(tcp::socket socket)
         std::istream is(&buffer);
         std::string message;
         std::getline(is, message);
+        registryMetrics().bytesIn.inc(message.size() + 1);
 
-        std::cout << "Received message: " << message << std::endl; // Log received message
+        logDebug("Received message: ", message); // Log received message
 
-        json request = json::parse(message);
-        if (request["requestType"] == "registering")
+        json request;
         {
-            json nodeInfo = {
-                {"Ip", request["Ip"]},
-                {"nodeType", request["nodeType"]},
-                {"computingCapacity", request["computingCapacity"]}};
-            registeredNodes.push_back(nodeInfo);
-            std::cout << "Node connected: " << nodeInfo.dump() << std::endl;
-
-            json discoveryMessage = {
-                {"requestType", "Node Discovery"},
-                {"nodes", registeredNodes},
-                {"metadataAnalyticsLeader", ""},
-                {"metadataIngestionLeader", ""},
-                {"initElectionIngestion", "127.0.0.1"}};
-
-            std::string discoveryMessageStr = discoveryMessage.dump() + "\n";
-            asio::write(socket, asio::buffer(discoveryMessageStr));
+            ScopedTimer timer(registryMetrics().parseSeconds);
+            request = json::parse(message);
+        }
+        auto requestType = request.find("requestType");
+        RequestType type = requestType != request.end() && requestType->is_string() ? parseRequestType(requestType->get_ref<const std::string &>()) : RequestType::Unknown;
+        const RegistryRoute *route = type == RequestType::Unknown ? nullptr : &registryRoutes()[static_cast<size_t>(type)];
+        if (route == nullptr || route->handler == nullptr)
+        {
+            registryMetrics().invalidMessages.inc();
+            logWarn("Received unknown request type: ", requestType != request.end() ? requestType->dump() : "none");
         }
         else
         {
-            std::cerr << "Received unknown request type: " << request["requestType"] << std::endl;
+            route->messages->inc();
+            route->handler(socket, request);
         }
 
         socket.close();
     }
     catch (std::exception &e)
     {
-        std::cerr << "Exception in client handling: " << e.what() << std::endl;
+        logError("Exception in client handling: ", e.what());
+    }
+    registryMetrics().activeConnections.add(-1);
+}
+
+// Rebuilds membership from the journal's snapshot and logged changes. Restored
+// nodes get a fresh lease: live ones keep it with their next heartbeat instead
+// of having to re-register, dead ones expire as usual.
+void restoreRegistry()
+{
+    RegistryJournal::State state = journal->load();
+    if (state.unreadableLines > 0)
+    {
+        logWarn("Skipped ", state.unreadableLines, " unreadable lines of the registry journal");
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto restoreNode = [&](const json &nodeInfo)
+    {
+        NodeRecord node = NodeRecord::fromJson(nodeInfo);
+        node.expiresAt = now + leaseDuration;
+        registeredNodes.upsert(node);
+        leaseTimers.schedule(node.ip, node.expiresAt);
+    };
+    auto restoreLeader = [&](const std::string &name, const std::string &ip, uint64_t term)
+    {
+        for (auto &role : leaderRoles)
+        {
+            if (name == role.name)
+            {
+                role.ip = ip;
+                role.term = term;
+                role.expiresAt = now + leaderLeaseDuration;
+            }
+        }
+    };
+
+    if (!state.snapshot.is_null())
+    {
+        try
+        {
+            uint64_t snapshotEpoch = state.snapshot.at("epoch");
+            uint64_t snapshotVersion = state.snapshot.at("version");
+            registryEpoch = snapshotEpoch;
+            membershipVersion = snapshotVersion;
+        }
+        catch (const std::exception &e)
+        {
+            logError("Ignoring unreadable registry snapshot: ", e.what());
+            state.snapshot = nullptr;
+        }
+    }
+    if (!state.snapshot.is_null())
+    {
+        json nodes = state.snapshot.value("nodes", json::array());
+        json leaderTerms = state.snapshot.value("leaderTerms", json::object());
+        for (const auto &nodeInfo : nodes)
+        {
+            try
+            {
+                restoreNode(nodeInfo);
+            }
+            catch (const std::exception &e)
+            {
+                logWarn("Skipping unreadable snapshot node ", nodeInfo.dump(), ": ", e.what());
+            }
+        }
+        for (const auto &[name, term] : leaderTerms.items())
+        {
+            try
+            {
+                restoreLeader(name, state.snapshot.value(name, ""), term.get<uint64_t>());
+            }
+            catch (const std::exception &e)
+            {
+                logWarn("Skipping unreadable snapshot leader ", name, ": ", e.what());
+            }
+        }
+    }
+    for (const auto &change : state.changes)
+    {
+        // A truncated or hand-edited entry is skipped rather than failing the restart
+        try
+        {
+            uint64_t version = change.at("version");
+            const std::string &op = change.at("op").get_ref<const std::string &>();
+            if (op == "removed")
+            {
+                registeredNodes.erase(change.at("node").at("Ip").get<std::string>());
+            }
+            else if (op == "leader")
+            {
+                restoreLeader(change.at("role"), change.at("Ip"), change.at("term"));
+            }
+            else
+            {
+                restoreNode(change.at("node"));
+            }
+            membershipVersion = version;
+            changeLog.push_back(change);
+        }
+        catch (const std::exception &e)
+        {
+            logWarn("Skipping unreadable journal entry ", change.dump(), ": ", e.what());
+            changeLog.clear(); // Deltas need consecutive versions; subscribers get a snapshot instead
+        }
+    }
+    while (changeLog.size() > changeLogCapacity)
+    {
+        changeLog.pop_front();
+    }
+
+    registryMetrics().registeredNodeCount.set(static_cast<int64_t>(registeredNodes.size()));
+    registryMetrics().version.set(static_cast<int64_t>(membershipVersion));
+    logInfo("Restored ", registeredNodes.size(), " nodes at membership version ", membershipVersion);
+    journal->writeSnapshot(discoverySnapshot());
+}
+
+// Compacts the journal: a new snapshot replaces the changes logged since the last one.
+void snapshotRegistry()
+{
+    while (true)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(30));
+        std::unique_lock<std::shared_mutex> lock(registryMutex);
+        if (journal->entriesSinceSnapshot() > 0 && !journal->writeSnapshot(discoverySnapshot()))
+        {
+            logError("Failed to write registry snapshot");
+        }
     }
 }
 
@@ -61,24 +546,54 @@ void startServer(asio::io_context &io_context, unsigned short port)
     {
         tcp::socket socket(io_context);
         acceptor.accept(socket);
-        std::cout << "Accepted connection from: " << socket.remote_endpoint() << std::endl; // Log connection acceptance
+        logDebug("Accepted connection from: ", socket.remote_endpoint()); // Log connection acceptance
         std::thread(handleClient, std::move(socket)).detach();
     }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    ServerConfig defaults;
+    defaults.port = 12345;
+    ServerConfig config;
+    try
+    {
+        config = ServerConfig::parse(argc, argv, defaults);
+        if (config.arguments.size() > 1)
+        {
+            throw std::invalid_argument("Too many arguments");
+        }
+        config.resolvedMetricsPort();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [STATE_DIR] [--config FILE] [--port PORT] [--metrics-address IP] [--metrics-port PORT]" << std::endl;
+        return 1;
+    }
+    unsigned short port = config.port;
+
+    registryMetrics();
+    registryRoutes();
+    startMetricsServer(config.resolvedMetricsPort(), config.metricsAddress);
+
+    // Membership is kept in <STATE_DIR>/registry.snapshot and registry.log
+    journal = std::make_unique<RegistryJournal>(config.arguments.empty() ? "." : config.arguments[0]);
+    restoreRegistry();
+
     try
     {
         asio::io_context io_context;
-        std::thread serverThread([&io_context]()
-                                 { startServer(io_context, 12345); });
+        std::thread serverThread([&io_context, port]()
+                                 { startServer(io_context, port); });
+        std::thread(expireLeases).detach();
+        std::thread(snapshotRegistry).detach();
 
         serverThread.join();
     }
     catch (std::exception &e)
     {
-        std::cerr << "Exception in server: " << e.what() << std::endl;
+        logError("Exception in server: ", e.what());
     }
 
     return 0;
@@ -0,0 +1,84 @@
+#pragma once
+
+// Set of 64-bit row identities used to drop re-sent readings at ingest.
+//
+// Open addressing with linear probing over a flat array of keys: one 8-byte
+// slot per entry (at most 75% load), no per-entry allocation, and an O(1)
+// expected insert-or-detect per row.
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class DedupIndex
+{
+public:
+    // Returns true if `key` was not present (and records it), false for a duplicate.
+    bool insert(uint64_t key)
+    {
+        if (key == emptyKey)
+        {
+            // The sentinel value cannot live in the table; track it separately
+            bool inserted = !containsEmptyKey;
+            containsEmptyKey = true;
+            return inserted;
+        }
+        if ((used + 1) * 4 > slots.size() * 3)
+        {
+            grow();
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t index = mix(key) & mask;; index = (index + 1) & mask)
+        {
+            if (slots[index] == key)
+            {
+                return false;
+            }
+            if (slots[index] == emptyKey)
+            {
+                slots[index] = key;
+                ++used;
+                return true;
+            }
+        }
+    }
+
+    size_t size() const { return used + (containsEmptyKey ? 1 : 0); }
+
+private:
+    static constexpr uint64_t emptyKey = ~uint64_t(0);
+
+    static uint64_t mix(uint64_t key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    void grow()
+    {
+        std::vector<uint64_t> previous = std::move(slots);
+        slots.assign(previous.empty() ? 1024 : previous.size() * 2, emptyKey);
+        size_t mask = slots.size() - 1;
+        for (uint64_t key : previous)
+        {
+            if (key == emptyKey)
+            {
+                continue;
+            }
+            size_t index = mix(key) & mask;
+            while (slots[index] != emptyKey)
+            {
+                index = (index + 1) & mask;
+            }
+            slots[index] = key;
+        }
+    }
+
+    std::vector<uint64_t> slots;
+    size_t used = 0;
+    bool containsEmptyKey = false;
+};
@@ -1,7 +1,20 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <asio.hpp>
 #include "json.hpp"
+#include "bulk_loader.hpp"
+#include "message_codec.hpp"
+#include "synthetic_rows.hpp"
 
 using json = nlohmann::json;
 using asio::ip::tcp;
@@ -71,8 +84,432 @@ void sendQueryRequest(const std::string &serverIp, unsigned short port, int requ
     }
 }
 
-int main()
+struct LoadOptions
 {
+    std::string serverIp = "127.0.0.1";
+    unsigned short port = 12459;
+    size_t rowsPerBatch = 100;
+    double batchesPerSecond = 100.0;
+    int connections = 4;
+    double queryRatio = 0.1;
+    double durationSeconds = 10.0;
+    int areas = 500;
+    unsigned short ackPort = 12458;
+    unsigned short responsePort = 12460;
+    CompressionPolicy compression;
+};
+
+// Send times of outstanding requests and the observed reply latencies, shared
+// between the sender threads and the ack/response listeners.
+struct LatencyTracker
+{
+    std::mutex mutex;
+    std::unordered_map<int, std::chrono::steady_clock::time_point> pending;
+    std::vector<double> latencies;
+
+    void sent(int requestId)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[requestId] = std::chrono::steady_clock::now();
+    }
+
+    void received(int requestId)
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = pending.find(requestId);
+        if (it != pending.end())
+        {
+            latencies.push_back(std::chrono::duration<double>(now - it->second).count());
+            pending.erase(it);
+        }
+    }
+};
+
+// Stands in for the metadata analytics server on the ack/response ports so that
+// replies from the analytics node can be matched to the requests we sent.
+void listenForReplies(unsigned short port, LatencyTracker &tracker, std::atomic<bool> &running)
+{
+    try
+    {
+        asio::io_context io_context;
+        tcp::acceptor acceptor(io_context, tcp::endpoint(tcp::v4(), port));
+        while (running)
+        {
+            tcp::socket socket(io_context);
+            acceptor.accept(socket);
+            try
+            {
+                size_t wireBytes = 0;
+                json reply = json::parse(readMessage(socket, wireBytes));
+                tracker.received(reply["requestID"]);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Exception reading reply: " << e.what() << std::endl;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception in reply listener: " << e.what() << std::endl;
+    }
+}
+
+void sendMessage(const LoadOptions &options, const json &request)
+{
+    asio::io_context io_context;
+    tcp::resolver resolver(io_context);
+    tcp::resolver::results_type endpoints = resolver.resolve(options.serverIp, std::to_string(options.port));
+
+    tcp::socket socket(io_context);
+    asio::connect(socket, endpoints);
+
+    std::string message = encodeMessage(request.dump(), options.compression);
+    asio::write(socket, asio::buffer(message));
+    socket.close();
+}
+
+void printLatencies(const std::string &name, std::vector<double> samples, size_t outstanding)
+{
+    std::sort(samples.begin(), samples.end());
+    std::cout << name << " latency: ";
+    if (samples.empty())
+    {
+        std::cout << "no replies";
+    }
+    else
+    {
+        auto percentile = [&](double p)
+        { return samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * p))] * 1e3; };
+        std::cout << "p50 " << percentile(0.50) << " ms, p99 " << percentile(0.99) << " ms, max " << samples.back() * 1e3 << " ms";
+    }
+    std::cout << " (" << samples.size() << " replies, " << outstanding << " unanswered)" << std::endl;
+}
+
+void runLoadGenerator(const LoadOptions &options)
+{
+    LatencyTracker ackTracker;
+    LatencyTracker queryTracker;
+    std::atomic<bool> running{true};
+    std::thread(listenForReplies, options.ackPort, std::ref(ackTracker), std::ref(running)).detach();
+    std::thread(listenForReplies, options.responsePort, std::ref(queryTracker), std::ref(running)).detach();
+
+    std::atomic<int> nextRequestId{1};
+    std::atomic<size_t> batchesSent{0};
+    std::atomic<size_t> rowsSent{0};
+    std::atomic<size_t> queriesSent{0};
+    std::atomic<size_t> sendErrors{0};
+    std::atomic<size_t> nextRow{0}; // Position in the synthetic row sequence, shared so connections send distinct readings
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.durationSeconds));
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(options.connections / options.batchesPerSecond));
+
+    std::vector<std::thread> senders;
+    for (int connection = 0; connection < options.connections; ++connection)
+    {
+        senders.emplace_back([&, connection]()
+                             {
+            std::mt19937 rng(connection + 1);
+            std::uniform_real_distribution<double> mixDist(0.0, 1.0);
+            auto nextSend = start + interval * connection / options.connections;
+            while (nextSend < deadline)
+            {
+                std::this_thread::sleep_until(nextSend);
+                nextSend += interval;
+
+                int requestId = nextRequestId++;
+                try
+                {
+                    if (mixDist(rng) < options.queryRatio)
+                    {
+                        json queryRequest = {
+                            {"requestType", "query"},
+                            {"requestID", requestId},
+                            {"query", static_cast<int>(mixDist(rng) * 2)}};
+                        queryTracker.sent(requestId);
+                        sendMessage(options, queryRequest);
+                        ++queriesSent;
+                    }
+                    else
+                    {
+                        json analyticsRequest = {
+                            {"requestType", "analytics"},
+                            {"requestID", requestId},
+                            {"Data", generateRows(options.rowsPerBatch, rng, nextRow.fetch_add(options.rowsPerBatch), options.areas)}};
+                        ackTracker.sent(requestId);
+                        sendMessage(options, analyticsRequest);
+                        ++batchesSent;
+                        rowsSent += options.rowsPerBatch;
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    ++sendErrors;
+                }
+            } });
+    }
+    for (auto &sender : senders)
+    {
+        sender.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Give in-flight acknowledgments and query responses a moment to arrive
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    running = false;
+
+    std::cout << "Sent " << batchesSent << " batches (" << rowsSent << " rows) and " << queriesSent << " queries in " << elapsed << " s, "
+              << sendErrors << " send errors" << std::endl;
+    std::cout << "Throughput: " << rowsSent / elapsed << " rows/s, " << (batchesSent + queriesSent) / elapsed << " messages/s" << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(ackTracker.mutex);
+        printLatencies("Ack", ackTracker.latencies, ackTracker.pending.size());
+    }
+    {
+        std::lock_guard<std::mutex> lock(queryTracker.mutex);
+        printLatencies("Query", queryTracker.latencies, queryTracker.pending.size());
+    }
+}
+
+// Sends requests that are missing required keys or carry mistyped ones, then a
+// valid query, and checks that the node survived to answer it. Returns false
+// if no response arrives.
+bool runMalformedCheck(const LoadOptions &options)
+{
+    LatencyTracker queryTracker;
+    std::atomic<bool> running{true};
+    std::thread(listenForReplies, options.responsePort, std::ref(queryTracker), std::ref(running)).detach();
+
+    const std::vector<json> malformed = {
+        {{"requestType", "query"}, {"requestID", 1}},
+        {{"requestType", "query"}, {"query", 0}},
+        {{"requestType", "query"}, {"requestID", 2}, {"query", "0"}},
+        {{"requestType", "query"}, {"requestID", 3}, {"query", 5}},
+        {{"requestType", "analytics"}, {"requestID", 4}},
+        {{"requestType", "analytics"}, {"requestID", 5}, {"Data", "rows"}},
+        {{"requestType", "bulk load"}, {"requestID", 6}},
+        {{"requestType", "Init Analytics"}},
+        {{"requestID", 7}}};
+    for (const auto &request : malformed)
+    {
+        sendMessage(options, request);
+    }
+
+    const int probeId = 1000;
+    queryTracker.sent(probeId);
+    sendMessage(options, {{"requestType", "query"}, {"requestID", probeId}, {"query", 0}});
+    bool answered = false;
+    for (int attempt = 0; attempt < 30 && !answered; ++attempt)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::lock_guard<std::mutex> lock(queryTracker.mutex);
+        answered = queryTracker.pending.empty();
+    }
+    running = false;
+
+    std::cout << "Sent " << malformed.size() << " malformed requests; node " << (answered ? "answered" : "did not answer")
+              << " the following query" << std::endl;
+    return answered;
+}
+
+struct BulkOptions
+{
+    std::string path;
+    LoadOptions connection; // Server, port and compression
+    size_t batchSize = 10000;
+    size_t threads = std::thread::hardware_concurrency();
+};
+
+// Parses `--bulk PATH [flags]`. Returns false, after printing why, on an
+// unknown option, a missing value or a value that is not a number.
+bool parseBulkOptions(int argc, char *argv[], BulkOptions &options)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Missing file for --bulk" << std::endl;
+        return false;
+    }
+    options.path = argv[2];
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try
+        {
+            if (flag == "--server")
+                options.connection.serverIp = value;
+            else if (flag == "--port")
+                options.connection.port = static_cast<unsigned short>(std::stoi(value));
+            else if (flag == "--batch-size")
+                options.batchSize = std::stoul(value);
+            else if (flag == "--threads")
+                options.threads = std::stoul(value);
+            else if (flag == "--compress")
+                options.connection.compression.codec = value == "lz" ? MessageCodec::Lz : MessageCodec::None;
+            else if (flag == "--compress-threshold")
+                options.connection.compression.threshold = std::stoul(value);
+            else
+            {
+                std::cerr << "Unknown option " << flag << std::endl;
+                return false;
+            }
+        }
+        catch (const std::logic_error &)
+        {
+            std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parses a CSV/JSONL file in parallel and streams it as large "analytics" batches.
+void runBulkIngestion(const BulkOptions &bulk)
+{
+    const std::string &path = bulk.path;
+    const LoadOptions &options = bulk.connection;
+
+    std::atomic<int> nextRequestId{1};
+    std::atomic<size_t> sendErrors{0};
+    auto start = std::chrono::steady_clock::now();
+    BulkLoadResult loaded = loadRowsParallel(path, bulk.batchSize, bulk.threads, [&](std::vector<std::vector<std::string>> &batch)
+                                             {
+        json analyticsRequest = {
+            {"requestType", "analytics"},
+            {"requestID", nextRequestId++},
+            {"Data", batch}};
+        try
+        {
+            sendMessage(options, analyticsRequest);
+        }
+        catch (const std::exception &e)
+        {
+            ++sendErrors;
+            std::cerr << "Exception sending batch: " << e.what() << std::endl;
+        } });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Bulk ingested " << loaded.rows << " rows from " << path << " in " << nextRequestId - 1 << " batches ("
+              << loaded.skippedLines << " lines skipped, " << sendErrors << " send errors) in " << elapsed << " s, "
+              << loaded.rows / elapsed << " rows/s" << std::endl;
+}
+
+// Returns false, after printing why, on an unknown option, a missing value or
+// a value that is not a number.
+bool parseLoadOptions(int argc, char *argv[], LoadOptions &options)
+{
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try
+        {
+            if (flag == "--server")
+                options.serverIp = value;
+            else if (flag == "--port")
+                options.port = static_cast<unsigned short>(std::stoi(value));
+            else if (flag == "--rows-per-batch")
+                options.rowsPerBatch = std::stoul(value);
+            else if (flag == "--batches-per-sec")
+                options.batchesPerSecond = std::stod(value);
+            else if (flag == "--connections")
+                options.connections = std::max(1, std::stoi(value));
+            else if (flag == "--query-ratio")
+                options.queryRatio = std::stod(value);
+            else if (flag == "--duration")
+                options.durationSeconds = std::stod(value);
+            else if (flag == "--areas")
+                options.areas = std::max(1, std::stoi(value));
+            else if (flag == "--ack-port")
+                options.ackPort = static_cast<unsigned short>(std::stoi(value));
+            else if (flag == "--response-port")
+                options.responsePort = static_cast<unsigned short>(std::stoi(value));
+            else if (flag == "--compress")
+                options.compression.codec = value == "lz" ? MessageCodec::Lz : MessageCodec::None;
+            else if (flag == "--compress-threshold")
+                options.compression.threshold = std::stoul(value);
+            else
+            {
+                std::cerr << "Unknown option " << flag << std::endl;
+                return false;
+            }
+        }
+        catch (const std::logic_error &)
+        {
+            std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return options.batchesPerSecond > 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "--load")
+    {
+        LoadOptions options;
+        if (!parseLoadOptions(argc, argv, options))
+        {
+            std::cerr << "Usage: " << argv[0] << " --load [--server IP] [--port PORT] [--rows-per-batch N] [--batches-per-sec N]"
+                      << " [--connections N] [--query-ratio F] [--duration SECONDS] [--areas N] [--ack-port PORT] [--response-port PORT]"
+                      << " [--compress lz|none] [--compress-threshold BYTES]" << std::endl;
+            return 1;
+        }
+        runLoadGenerator(options);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--check-malformed")
+    {
+        LoadOptions options;
+        if (!parseLoadOptions(argc, argv, options))
+        {
+            std::cerr << "Usage: " << argv[0] << " --check-malformed [--server IP] [--port PORT] [--response-port PORT]" << std::endl;
+            return 1;
+        }
+        try
+        {
+            return runMalformedCheck(options) ? 0 : 1;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bulk")
+    {
+        BulkOptions options;
+        if (!parseBulkOptions(argc, argv, options))
+        {
+            std::cerr << "Usage: " << argv[0] << " --bulk FILE [--server IP] [--port PORT] [--batch-size N] [--threads N]"
+                      << " [--compress lz|none] [--compress-threshold BYTES]" << std::endl;
+            return 1;
+        }
+        try
+        {
+            runBulkIngestion(options);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Exception: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     std::vector<std::vector<std::string>> data = {
         {"2020-08-10T01:00@0", "41.75613", "-124.20347", "PM2.5", "17.3", "UG/M3", "18.0", "62", "2", "Crescent City", "North Coast Unified Air Quality Management District", "840060150007", "840060150007"},
         {"2020-08-10T02:00@1", "41.75613", "-124.20347", "PM2.5", "20.1", "UG/M3", "20.0", "60", "3", "Crescent City", "North Coast Unified Air Quality Management District", "840060150007", "840060150007"}};
@@ -0,0 +1,158 @@
+#pragma once
+
+// Latitude/longitude grid index for regional queries.
+//
+// Rows are bucketed into fixed cellDegrees x cellDegrees cells at ingest. Each
+// cell keeps its running aggregate and the indexes of its rows, so a region
+// query uses the aggregate of every cell lying fully inside the region and
+// only scans the rows of cells crossing its boundary.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "group_by.hpp"
+
+inline double haversineKm(double lat1, double lon1, double lat2, double lon2)
+{
+    constexpr double earthRadiusKm = 6371.0;
+    constexpr double toRadians = M_PI / 180.0;
+    double dLat = (lat2 - lat1) * toRadians;
+    double dLon = (lon2 - lon1) * toRadians;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::cos(lat1 * toRadians) * std::cos(lat2 * toRadians) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2.0 * earthRadiusKm * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+// A bounding box, or a circle (center + radius) with its bounding box.
+struct GeoRegion
+{
+    double minLat = -90.0;
+    double minLon = -180.0;
+    double maxLat = 90.0;
+    double maxLon = 180.0;
+    bool isCircle = false;
+    double centerLat = 0.0;
+    double centerLon = 0.0;
+    double radiusKm = 0.0;
+
+    static GeoRegion boundingBox(double minLat, double minLon, double maxLat, double maxLon)
+    {
+        GeoRegion region;
+        region.minLat = std::min(minLat, maxLat);
+        region.maxLat = std::max(minLat, maxLat);
+        region.minLon = std::min(minLon, maxLon);
+        region.maxLon = std::max(minLon, maxLon);
+        return region;
+    }
+
+    static GeoRegion circle(double lat, double lon, double radiusKm)
+    {
+        constexpr double kmPerDegree = 111.32;
+        double latSpan = radiusKm / kmPerDegree;
+        double lonSpan = radiusKm / (kmPerDegree * std::max(0.01, std::cos(lat * M_PI / 180.0)));
+        GeoRegion region = boundingBox(lat - latSpan, lon - lonSpan, lat + latSpan, lon + lonSpan);
+        region.isCircle = true;
+        region.centerLat = lat;
+        region.centerLon = lon;
+        region.radiusKm = radiusKm;
+        return region;
+    }
+
+    bool contains(double lat, double lon) const
+    {
+        if (lat < minLat || lat > maxLat || lon < minLon || lon > maxLon)
+        {
+            return false;
+        }
+        return !isCircle || haversineKm(centerLat, centerLon, lat, lon) <= radiusKm;
+    }
+};
+
+class GeoGridIndex
+{
+public:
+    static constexpr double cellDegrees = 0.1;
+
+    struct Cell
+    {
+        GroupAccumulator totals;
+        uint32_t maxRow = 0;
+        std::vector<uint32_t> rows;
+    };
+
+    void add(uint32_t row, double lat, double lon, double value)
+    {
+        Cell &cell = cells[cellKey(latIndex(lat), lonIndex(lon))];
+        if (cell.totals.count == 0 || value > cell.totals.max)
+        {
+            cell.maxRow = row;
+        }
+        cell.totals.add(value);
+        cell.rows.push_back(row);
+    }
+
+    // Calls visitor(key, cell, fullyInside) for every non-empty cell that
+    // overlaps `region`. When fullyInside is false the caller must test rows.
+    template <typename Visitor>
+    void forEachCell(const GeoRegion &region, Visitor visitor) const
+    {
+        int64_t firstLat = latIndex(region.minLat);
+        int64_t lastLat = latIndex(region.maxLat);
+        int64_t firstLon = lonIndex(region.minLon);
+        int64_t lastLon = lonIndex(region.maxLon);
+        auto visit = [&](uint64_t key, const Cell &cell)
+        {
+            visitor(key, cell, cellInside(region, key));
+        };
+
+        uint64_t rangeCells = static_cast<uint64_t>(lastLat - firstLat + 1) * static_cast<uint64_t>(lastLon - firstLon + 1);
+        if (rangeCells > cells.size())
+        {
+            // Sparse data over a large region: walk the occupied cells instead
+            for (const auto &[key, cell] : cells)
+            {
+                int64_t latCell = static_cast<int64_t>(key >> 32);
+                int64_t lonCell = static_cast<int64_t>(key & 0xffffffffULL);
+                if (latCell >= firstLat && latCell <= lastLat && lonCell >= firstLon && lonCell <= lastLon)
+                {
+                    visit(key, cell);
+                }
+            }
+            return;
+        }
+        for (int64_t latCell = firstLat; latCell <= lastLat; ++latCell)
+        {
+            for (int64_t lonCell = firstLon; lonCell <= lastLon; ++lonCell)
+            {
+                auto it = cells.find(cellKey(latCell, lonCell));
+                if (it != cells.end())
+                {
+                    visit(it->first, it->second);
+                }
+            }
+        }
+    }
+
+    // South-west corner of a cell.
+    static double cellLat(uint64_t key) { return static_cast<double>(key >> 32) * cellDegrees - 90.0; }
+    static double cellLon(uint64_t key) { return static_cast<double>(key & 0xffffffffULL) * cellDegrees - 180.0; }
+
+private:
+    static int64_t latIndex(double lat) { return static_cast<int64_t>(std::floor((std::clamp(lat, -90.0, 90.0) + 90.0) / cellDegrees)); }
+    static int64_t lonIndex(double lon) { return static_cast<int64_t>(std::floor((std::clamp(lon, -180.0, 180.0) + 180.0) / cellDegrees)); }
+    static uint64_t cellKey(int64_t latCell, int64_t lonCell) { return static_cast<uint64_t>(latCell) << 32 | static_cast<uint64_t>(lonCell); }
+
+    static bool cellInside(const GeoRegion &region, uint64_t key)
+    {
+        double south = cellLat(key);
+        double west = cellLon(key);
+        double north = south + cellDegrees;
+        double east = west + cellDegrees;
+        return region.contains(south, west) && region.contains(south, east) &&
+               region.contains(north, west) && region.contains(north, east);
+    }
+
+    std::unordered_map<uint64_t, Cell> cells;
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+// Allocation-free group-by aggregation for queries.
+//
+// DenseGroupBy indexes a flat accumulator array directly by an interned ID, so
+// aggregating a row is one array access. FlatGroupBy is an open-addressing
+// (linear probing) hash table for sparse 64-bit keys such as grid cells, with
+// the accumulators stored inline next to the keys.
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct GroupAccumulator
+{
+    double sum = 0.0;
+    uint64_t count = 0;
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double value)
+    {
+        sum += value;
+        ++count;
+        if (value > max)
+        {
+            max = value;
+        }
+    }
+
+    void merge(const GroupAccumulator &other)
+    {
+        sum += other.sum;
+        count += other.count;
+        if (other.max > max)
+        {
+            max = other.max;
+        }
+    }
+
+    double average() const { return count == 0 ? 0.0 : sum / count; }
+};
+
+class DenseGroupBy
+{
+public:
+    explicit DenseGroupBy(size_t groupCount) : groups(groupCount) {}
+
+    void add(uint32_t key, double value) { groups[key].add(value); }
+
+    GroupAccumulator &operator[](uint32_t key) { return groups[key]; }
+    const GroupAccumulator &operator[](uint32_t key) const { return groups[key]; }
+    size_t size() const { return groups.size(); }
+
+    template <typename Visitor>
+    void forEach(Visitor visitor) const
+    {
+        for (uint32_t key = 0; key < groups.size(); ++key)
+        {
+            if (groups[key].count > 0)
+            {
+                visitor(key, groups[key]);
+            }
+        }
+    }
+
+private:
+    std::vector<GroupAccumulator> groups;
+};
+
+class FlatGroupBy
+{
+public:
+    explicit FlatGroupBy(size_t expectedKeys = 16) { rehash(capacityFor(expectedKeys)); }
+
+    GroupAccumulator &operator[](uint64_t key)
+    {
+        if ((used + 1) * 4 > slots.size() * 3)
+        {
+            rehash(slots.size() * 2);
+        }
+        size_t index = probe(key);
+        if (!slots[index].occupied)
+        {
+            slots[index].occupied = true;
+            slots[index].key = key;
+            ++used;
+        }
+        return slots[index].accumulator;
+    }
+
+    void add(uint64_t key, double value) { (*this)[key].add(value); }
+
+    size_t size() const { return used; }
+
+    template <typename Visitor>
+    void forEach(Visitor visitor) const
+    {
+        for (const auto &slot : slots)
+        {
+            if (slot.occupied)
+            {
+                visitor(slot.key, slot.accumulator);
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        uint64_t key = 0;
+        bool occupied = false;
+        GroupAccumulator accumulator;
+    };
+
+    static size_t capacityFor(size_t keys)
+    {
+        size_t capacity = 16;
+        while (capacity * 3 < keys * 4)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    static uint64_t mix(uint64_t key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    size_t probe(uint64_t key) const
+    {
+        size_t mask = slots.size() - 1;
+        size_t index = mix(key) & mask;
+        while (slots[index].occupied && slots[index].key != key)
+        {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<Slot> previous;
+        previous.swap(slots);
+        slots.resize(capacity);
+        for (const auto &slot : previous)
+        {
+            if (slot.occupied)
+            {
+                slots[probe(slot.key)] = slot;
+            }
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t used = 0;
+};
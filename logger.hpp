@@ -0,0 +1,241 @@
+#pragma once
+
+// Asynchronous leveled logger shared by all servers.
+//
+// Handler threads format their line and push it into a bounded lock-free ring
+// buffer; a single background thread drains the ring into stdout/stderr. When
+// the ring is full the line is dropped and counted rather than blocking the
+// caller, so logging can never throttle ingestion.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+enum class LogLevel
+{
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3
+};
+
+class AsyncLogger
+{
+public:
+    explicit AsyncLogger(size_t capacity = 1 << 14)
+        : mask(roundUpToPowerOfTwo(capacity) - 1), slots(new Slot[mask + 1])
+    {
+        for (size_t i = 0; i <= mask; ++i)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        minLevel.store(levelFromEnvironment(), std::memory_order_relaxed);
+        flusher = std::thread([this]()
+                              { flushLoop(); });
+    }
+
+    ~AsyncLogger()
+    {
+        stopping.store(true, std::memory_order_release);
+        flusher.join();
+    }
+
+    bool enabled(LogLevel level) const
+    {
+        return static_cast<int>(level) >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(LogLevel level) { minLevel.store(static_cast<int>(level), std::memory_order_relaxed); }
+
+    // Multi-producer enqueue (bounded MPMC ring with per-slot sequence numbers).
+    void push(LogLevel level, std::string line)
+    {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true)
+        {
+            slot = &slots[position & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+            {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        slot->level = level;
+        slot->line = std::move(line);
+        slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence{0};
+        LogLevel level = LogLevel::Info;
+        std::string line;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 1;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    // ANALYTICS_LOG_LEVEL=debug|info|warn|error, defaulting to info.
+    static int levelFromEnvironment()
+    {
+        const char *value = std::getenv("ANALYTICS_LOG_LEVEL");
+        if (value == nullptr)
+        {
+            return static_cast<int>(LogLevel::Info);
+        }
+        std::string level = value;
+        if (level == "debug")
+            return static_cast<int>(LogLevel::Debug);
+        if (level == "warn")
+            return static_cast<int>(LogLevel::Warn);
+        if (level == "error")
+            return static_cast<int>(LogLevel::Error);
+        return static_cast<int>(LogLevel::Info);
+    }
+
+    // Single consumer: only the flusher thread dequeues.
+    bool pop(LogLevel &level, std::string &line)
+    {
+        Slot &slot = slots[dequeuePosition & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePosition + 1)
+        {
+            return false;
+        }
+        level = slot.level;
+        line = std::move(slot.line);
+        slot.line.clear();
+        slot.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+        ++dequeuePosition;
+        return true;
+    }
+
+    void flushLoop()
+    {
+        LogLevel level;
+        std::string line;
+        while (true)
+        {
+            bool wroteAny = false;
+            while (pop(level, line))
+            {
+                std::ostream &out = level >= LogLevel::Warn ? std::cerr : std::cout;
+                out << line << '\n';
+                wroteAny = true;
+            }
+
+            uint64_t droppedLines = dropped.exchange(0, std::memory_order_relaxed);
+            if (droppedLines > 0)
+            {
+                std::cerr << "Logger dropped " << droppedLines << " lines (ring buffer full)" << '\n';
+            }
+
+            if (wroteAny)
+            {
+                std::cout.flush();
+                std::cerr.flush();
+                continue;
+            }
+            if (stopping.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    const size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> enqueuePosition{0};
+    alignas(64) size_t dequeuePosition = 0;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<int> minLevel{static_cast<int>(LogLevel::Info)};
+    std::atomic<bool> stopping{false};
+    std::thread flusher;
+};
+
+inline AsyncLogger &logger()
+{
+    static AsyncLogger instance;
+    return instance;
+}
+
+// Allows at most `perSecond` events per one-second window; used to bound
+// high-volume debug output such as per-row ingestion logging.
+class RateLimiter
+{
+public:
+    explicit RateLimiter(uint64_t perSecond) : perSecond(perSecond) {}
+
+    bool allow()
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+        int64_t window = currentWindow.load(std::memory_order_relaxed);
+        if (now != window && currentWindow.compare_exchange_strong(window, now, std::memory_order_relaxed))
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        return count.fetch_add(1, std::memory_order_relaxed) < perSecond;
+    }
+
+private:
+    const uint64_t perSecond;
+    std::atomic<int64_t> currentWindow{0};
+    std::atomic<uint64_t> count{0};
+};
+
+template <typename... Args>
+void logMessage(LogLevel level, Args &&...args)
+{
+    AsyncLogger &log = logger();
+    if (!log.enabled(level))
+    {
+        return;
+    }
+    std::ostringstream line;
+    (line << ... << std::forward<Args>(args));
+    log.push(level, line.str());
+}
+
+template <typename... Args>
+void logDebug(Args &&...args) { logMessage(LogLevel::Debug, std::forward<Args>(args)...); }
+
+template <typename... Args>
+void logInfo(Args &&...args) { logMessage(LogLevel::Info, std::forward<Args>(args)...); }
+
+template <typename... Args>
+void logWarn(Args &&...args) { logMessage(LogLevel::Warn, std::forward<Args>(args)...); }
+
+template <typename... Args>
+void logError(Args &&...args) { logMessage(LogLevel::Error, std::forward<Args>(args)...); }
@@ -0,0 +1,175 @@
+#pragma once
+
+// Node-side copy of the registry's versioned membership.
+//
+// A node subscribes once over a persistent connection:
+//   {"requestType": "subscribe", "epoch": E, "version": <last version seen, 0 if none>}
+// and the registry answers with what the node is missing: a full "Node
+// Discovery" snapshot, or a "Node Discovery Delta" carrying only the changes
+// since that version. It then pushes one delta line per batch of changes:
+//   {"requestType": "Node Discovery Delta", "epoch": E, "fromVersion": 41, "version": 43,
+//    "changes": [{"version": 42, "op": "added", "node": {"Ip": ...}},
+//                {"version": 43, "op": "removed", "node": {"Ip": ...}}]}
+// op is "added", "updated" (e.g. capacity changed) or "removed", each with the
+// node; or "leader" with "role" (e.g. "metadataAnalyticsLeader"), "Ip" ("" when
+// the role is vacant) and the election "term". Empty lines in between are
+// keepalives and carry nothing. The epoch
+// identifies the registry's version history; a node from another epoch (e.g.
+// before a registry restart) is sent a snapshot.
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <thread>
+#include <vector>
+#include <asio.hpp>
+#include "json.hpp"
+#include "logger.hpp"
+
+class MembershipView
+{
+public:
+    // Applies a snapshot or delta. Returns false if a delta does not follow on
+    // from the current version, in which case the caller should resubscribe.
+    bool apply(const nlohmann::json &message)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (message.at("requestType") == "Node Discovery")
+        {
+            nodesByIp.clear();
+            for (const auto &node : message.at("nodes"))
+            {
+                nodesByIp[node.at("Ip").get<std::string>()] = node;
+            }
+            leaders.clear();
+            for (const char *role : {"metadataAnalyticsLeader", "metadataIngestionLeader"})
+            {
+                leaders[role] = {message.value(role, ""), message.value("leaderTerms", nlohmann::json::object()).value(role, uint64_t(0))};
+            }
+            currentEpoch = message.value("epoch", uint64_t(0));
+            currentVersion = message.value("version", uint64_t(0));
+            return true;
+        }
+        if (message.value("epoch", uint64_t(0)) != currentEpoch || message.value("fromVersion", uint64_t(0)) != currentVersion)
+        {
+            return false;
+        }
+        for (const auto &change : message.at("changes"))
+        {
+            if (change.at("op") == "leader")
+            {
+                leaders[change.at("role").get<std::string>()] = {change.at("Ip").get<std::string>(), change.at("term").get<uint64_t>()};
+                continue;
+            }
+            std::string ip = change.at("node").at("Ip");
+            if (change.at("op") == "removed")
+            {
+                nodesByIp.erase(ip);
+            }
+            else
+            {
+                nodesByIp[ip] = change.at("node");
+            }
+        }
+        currentVersion = message.at("version");
+        return true;
+    }
+
+    uint64_t epoch() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return currentEpoch;
+    }
+
+    uint64_t version() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return currentVersion;
+    }
+
+    // Nodes of `nodeType` ("" for all), ordered by Ip.
+    std::vector<nlohmann::json> nodes(const std::string &nodeType = "") const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<nlohmann::json> result;
+        for (const auto &[ip, node] : nodesByIp)
+        {
+            if (nodeType.empty() || node.value("nodeType", "") == nodeType)
+            {
+                result.push_back(node);
+            }
+        }
+        return result;
+    }
+
+    // Ip of the current holder of `role` ("" if vacant) and its election term.
+    std::pair<std::string, uint64_t> leader(const std::string &role) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = leaders.find(role);
+        return it == leaders.end() ? std::pair<std::string, uint64_t>{"", 0} : it->second;
+    }
+
+private:
+    mutable std::shared_mutex mutex;
+    uint64_t currentEpoch = 0;
+    uint64_t currentVersion = 0;
+    std::map<std::string, nlohmann::json> nodesByIp;
+    std::map<std::string, std::pair<std::string, uint64_t>> leaders; // role -> (Ip, term)
+};
+
+// Keeps `view` in sync with the registry for the life of the process,
+// reconnecting (and resuming from the last applied version) when the
+// subscription drops.
+inline void followMembership(const std::string &registryIp, unsigned short port, MembershipView &view)
+{
+    using asio::ip::tcp;
+    while (true)
+    {
+        try
+        {
+            asio::io_context io_context;
+            tcp::resolver resolver(io_context);
+            tcp::socket socket(io_context);
+            asio::connect(socket, resolver.resolve(registryIp, std::to_string(port)));
+
+            nlohmann::json subscribe = {{"requestType", "subscribe"}, {"epoch", view.epoch()}, {"version", view.version()}};
+            std::string request = subscribe.dump() + "\n";
+            asio::write(socket, asio::buffer(request));
+
+            asio::streambuf buffer;
+            auto leader = view.leader("metadataAnalyticsLeader");
+            while (true)
+            {
+                asio::read_until(socket, buffer, "\n");
+                std::istream is(&buffer);
+                std::string line;
+                std::getline(is, line);
+                if (line.empty())
+                {
+                    continue; // Keepalive
+                }
+                if (!view.apply(nlohmann::json::parse(line)))
+                {
+                    logWarn("Membership delta out of sequence at version ", view.version(), ", resubscribing");
+                    break;
+                }
+                logDebug("Membership at version ", view.version(), ": ", view.nodes().size(), " nodes");
+                if (view.leader("metadataAnalyticsLeader") != leader)
+                {
+                    leader = view.leader("metadataAnalyticsLeader");
+                    logInfo("Metadata analytics leader: ", leader.first.empty() ? "none" : leader.first, " (term ", leader.second, ")");
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            logWarn("Membership subscription failed: ", e.what());
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
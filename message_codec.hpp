@@ -0,0 +1,272 @@
+#pragma once
+
+// Optional compression of messages on the wire.
+//
+// A message is either the usual JSON line, or a compressed frame:
+//   byte 0      frameMagic (0xC5, never the first byte of a JSON line)
+//   byte 1      codec (MessageCodec)
+//   bytes 2-5   uncompressed size, little endian
+//   bytes 6-9   payload size, little endian
+//   payload     the JSON text (no trailing newline) in that codec
+// Each connection carries one message, so the codec is chosen per connection
+// by the sender and declared in the frame; readMessage accepts both forms, and
+// peers that never compress keep speaking plain JSON lines.
+//
+// The Lz codec is an LZ4-style block format (literal runs and back-references
+// of at least 4 bytes within a 64 KiB window), which suits batches of
+// repetitive row fields: fast enough to run inline on every send.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <asio.hpp>
+
+enum class MessageCodec : uint8_t
+{
+    None = 0,
+    Lz = 1
+};
+
+constexpr unsigned char frameMagic = 0xC5;
+constexpr size_t frameHeaderSize = 10;
+// Largest message accepted in either form, uncompressed. A 50000-row bulk batch is about 10 MiB.
+constexpr size_t maxMessageSize = size_t(64) << 20;
+// An Lz payload byte decodes to at most 255 bytes (a run of 255-valued match
+// length bytes), so a frame declaring more is rejected before it is read.
+constexpr size_t lzMaxExpansion = 255;
+
+inline std::string lzCompress(std::string_view input)
+{
+    constexpr int hashBits = 14;
+    constexpr size_t minMatch = 4;
+    constexpr size_t maxOffset = 65535;
+
+    std::string output;
+    output.reserve(input.size() / 2 + 16);
+    std::vector<uint32_t> table(size_t(1) << hashBits, 0); // Last position + 1 per hash
+
+    auto read32 = [&](size_t position)
+    {
+        uint32_t value;
+        std::memcpy(&value, input.data() + position, sizeof(value));
+        return value;
+    };
+    auto writeLength = [&](size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            output.push_back(static_cast<char>(255));
+        }
+        output.push_back(static_cast<char>(length));
+    };
+    // Literals [literalStart, literalEnd) followed by a match (none when matchLength is 0)
+    auto emit = [&](size_t literalStart, size_t literalEnd, size_t matchLength, size_t offset)
+    {
+        size_t literals = literalEnd - literalStart;
+        size_t matchCode = matchLength > 0 ? matchLength - minMatch : 0;
+        output.push_back(static_cast<char>(std::min<size_t>(literals, 15) << 4 | std::min<size_t>(matchCode, 15)));
+        if (literals >= 15)
+        {
+            writeLength(literals - 15);
+        }
+        output.append(input.data() + literalStart, literals);
+        if (matchLength > 0)
+        {
+            output.push_back(static_cast<char>(offset & 0xff));
+            output.push_back(static_cast<char>(offset >> 8));
+            if (matchCode >= 15)
+            {
+                writeLength(matchCode - 15);
+            }
+        }
+    };
+
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + minMatch <= input.size())
+    {
+        uint32_t value = read32(position);
+        uint32_t &slot = table[(value * 2654435761U) >> (32 - hashBits)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(position + 1);
+        if (candidate == 0 || position + 1 - candidate > maxOffset || read32(candidate - 1) != value)
+        {
+            // Step faster through data that is not compressing
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t length = minMatch;
+        while (position + length < input.size() && input[match + length] == input[position + length])
+        {
+            ++length;
+        }
+        emit(anchor, position, length, position - match);
+        position += length;
+        anchor = position;
+    }
+    emit(anchor, input.size(), 0, 0);
+    return output;
+}
+
+// Throws std::runtime_error if `input` is not a valid block of `rawSize` bytes.
+inline std::string lzDecompress(std::string_view input, size_t rawSize)
+{
+    std::string output;
+    output.reserve(rawSize);
+    size_t in = 0;
+    auto readLength = [&](size_t length)
+    {
+        if (length < 15)
+        {
+            return length;
+        }
+        unsigned char extra;
+        do
+        {
+            if (in >= input.size())
+            {
+                throw std::runtime_error("Truncated compressed message");
+            }
+            extra = static_cast<unsigned char>(input[in++]);
+            length += extra;
+        } while (extra == 255);
+        return length;
+    };
+
+    while (in < input.size())
+    {
+        unsigned char token = static_cast<unsigned char>(input[in++]);
+        size_t literals = readLength(token >> 4);
+        if (literals > input.size() - in || output.size() + literals > rawSize)
+        {
+            throw std::runtime_error("Corrupt compressed message");
+        }
+        output.append(input.data() + in, literals);
+        in += literals;
+        if (in == input.size())
+        {
+            break; // The last sequence carries literals only
+        }
+
+        if (input.size() - in < 2)
+        {
+            throw std::runtime_error("Truncated compressed message");
+        }
+        size_t offset = static_cast<unsigned char>(input[in]) | static_cast<size_t>(static_cast<unsigned char>(input[in + 1])) << 8;
+        in += 2;
+        size_t length = readLength(token & 0x0f) + 4;
+        if (offset == 0 || offset > output.size() || output.size() + length > rawSize)
+        {
+            throw std::runtime_error("Corrupt compressed message");
+        }
+        size_t from = output.size() - offset;
+        if (offset >= length)
+        {
+            output.append(output, from, length);
+            continue;
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            output.push_back(output[from + i]); // Byte-wise: the match overlaps itself
+        }
+    }
+    if (output.size() != rawSize)
+    {
+        throw std::runtime_error("Compressed message has the wrong size");
+    }
+    return output;
+}
+
+// Which codec a sender uses, and from what message size.
+struct CompressionPolicy
+{
+    MessageCodec codec = MessageCodec::None;
+    size_t threshold = 4096; // Smaller messages are sent as plain JSON lines
+
+    // ANALYTICS_COMPRESSION=lz|none, ANALYTICS_COMPRESSION_THRESHOLD=<bytes>
+    static CompressionPolicy fromEnvironment()
+    {
+        CompressionPolicy policy;
+        if (const char *codec = std::getenv("ANALYTICS_COMPRESSION"))
+        {
+            policy.codec = std::string(codec) == "lz" ? MessageCodec::Lz : MessageCodec::None;
+        }
+        if (const char *threshold = std::getenv("ANALYTICS_COMPRESSION_THRESHOLD"))
+        {
+            policy.threshold = std::strtoull(threshold, nullptr, 10);
+        }
+        return policy;
+    }
+};
+
+// Wire form of a JSON message: a compressed frame when the policy applies and
+// it actually saves space, else the JSON line.
+inline std::string encodeMessage(const std::string &text, const CompressionPolicy &policy)
+{
+    if (policy.codec == MessageCodec::Lz && text.size() >= policy.threshold && text.size() <= maxMessageSize)
+    {
+        std::string payload = lzCompress(text);
+        if (payload.size() + frameHeaderSize < text.size())
+        {
+            std::string frame(frameHeaderSize, '\0');
+            frame[0] = static_cast<char>(frameMagic);
+            frame[1] = static_cast<char>(MessageCodec::Lz);
+            for (int i = 0; i < 4; ++i)
+            {
+                frame[2 + i] = static_cast<char>(text.size() >> (8 * i));
+                frame[6 + i] = static_cast<char>(payload.size() >> (8 * i));
+            }
+            return frame + payload;
+        }
+    }
+    return text + "\n";
+}
+
+// Reads one message in either form from `socket` and returns its JSON text;
+// `wireBytes` receives the number of bytes read off the connection.
+template <typename SyncReadStream>
+std::string readMessage(SyncReadStream &socket, size_t &wireBytes)
+{
+    // Bounded, so a line without a newline cannot grow it past maxMessageSize
+    asio::streambuf buffer(maxMessageSize + frameHeaderSize);
+    asio::read(socket, buffer, asio::transfer_exactly(1));
+    if (static_cast<unsigned char>(*asio::buffers_begin(buffer.data())) != frameMagic)
+    {
+        asio::read_until(socket, buffer, "\n");
+        std::istream is(&buffer);
+        std::string message;
+        std::getline(is, message);
+        wireBytes = message.size() + 1;
+        return message;
+    }
+
+    asio::read(socket, buffer, asio::transfer_exactly(frameHeaderSize - 1));
+    std::string header(asio::buffers_begin(buffer.data()), asio::buffers_end(buffer.data()));
+    buffer.consume(frameHeaderSize);
+    size_t rawSize = 0;
+    size_t payloadSize = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        rawSize |= static_cast<size_t>(static_cast<unsigned char>(header[2 + i])) << (8 * i);
+        payloadSize |= static_cast<size_t>(static_cast<unsigned char>(header[6 + i])) << (8 * i);
+    }
+    if (static_cast<MessageCodec>(header[1]) != MessageCodec::Lz || rawSize > maxMessageSize || payloadSize > rawSize ||
+        rawSize > payloadSize * lzMaxExpansion)
+    {
+        throw std::runtime_error("Unsupported compressed message frame");
+    }
+
+    // The buffer grows as payload bytes arrive rather than by the declared size
+    asio::read(socket, buffer, asio::transfer_exactly(payloadSize));
+    std::string payload(asio::buffers_begin(buffer.data()), asio::buffers_end(buffer.data()));
+    wireBytes = frameHeaderSize + payloadSize;
+    return lzDecompress(payload, rawSize);
+}
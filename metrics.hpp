@@ -0,0 +1,299 @@
+#pragma once
+
+// Prometheus-style metrics shared by all servers.
+//
+// Metrics are registered once at startup and then updated from handler threads
+// with relaxed atomics only, so instrumenting a hot path never takes a lock.
+// startMetricsServer() exposes the text exposition format over plain HTTP.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <asio.hpp>
+#include "logger.hpp"
+
+using MetricLabels = std::map<std::string, std::string>;
+
+class Counter
+{
+public:
+    void inc(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+class Gauge
+{
+public:
+    void set(int64_t newValue) { value.store(newValue, std::memory_order_relaxed); }
+    void add(int64_t amount) { value.fetch_add(amount, std::memory_order_relaxed); }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value{0};
+};
+
+// Fixed-bucket latency histogram. Observations are in seconds; buckets run
+// from 1us to 10s in a 1-2-5 progression, which covers everything from a JSON
+// parse to a full-table query.
+class Histogram
+{
+public:
+    static constexpr std::array<double, 22> bounds = {
+        1e-6, 2e-6, 5e-6, 1e-5, 2e-5, 5e-5, 1e-4, 2e-4, 5e-4, 1e-3, 2e-3,
+        5e-3, 1e-2, 2e-2, 5e-2, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0};
+
+    void observe(double seconds)
+    {
+        size_t bucket = 0;
+        while (bucket < bounds.size() && seconds > bounds[bucket])
+        {
+            ++bucket;
+        }
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sumNanos.fetch_add(static_cast<uint64_t>(seconds * 1e9), std::memory_order_relaxed);
+    }
+
+    uint64_t bucketCount(size_t bucket) const { return buckets[bucket].load(std::memory_order_relaxed); }
+    uint64_t totalCount() const { return count.load(std::memory_order_relaxed); }
+    double sum() const { return sumNanos.load(std::memory_order_relaxed) / 1e9; }
+
+private:
+    std::array<std::atomic<uint64_t>, bounds.size() + 1> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumNanos{0};
+};
+
+// Records the lifetime of the enclosing scope into a histogram.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Histogram &histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer()
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        histogram.observe(elapsed.count());
+    }
+
+private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+class MetricsRegistry
+{
+public:
+    Counter &counter(const std::string &name, const std::string &help, const MetricLabels &labels = {})
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return *add(counters, {name, help, labels, std::make_unique<Counter>()});
+    }
+
+    Gauge &gauge(const std::string &name, const std::string &help, const MetricLabels &labels = {})
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return *add(gauges, {name, help, labels, std::make_unique<Gauge>()});
+    }
+
+    Histogram &histogram(const std::string &name, const std::string &help, const MetricLabels &labels = {})
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return *add(histograms, {name, help, labels, std::make_unique<Histogram>()});
+    }
+
+    // Gauge whose value is computed at scrape time (e.g. resident memory).
+    void callbackGauge(const std::string &name, const std::string &help, std::function<double()> callback)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        add(callbacks, {name, help, {}, std::make_unique<std::function<double()>>(std::move(callback))});
+    }
+
+    std::string render() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream out;
+        out.precision(15);
+        std::string lastName;
+        auto header = [&](const std::string &name, const std::string &help, const char *type)
+        {
+            if (name != lastName)
+            {
+                out << "# HELP " << name << " " << help << "\n";
+                out << "# TYPE " << name << " " << type << "\n";
+                lastName = name;
+            }
+        };
+
+        for (const auto &entry : counters)
+        {
+            header(entry.name, entry.help, "counter");
+            out << entry.name << formatLabels(entry.labels) << " " << entry.metric->get() << "\n";
+        }
+        for (const auto &entry : gauges)
+        {
+            header(entry.name, entry.help, "gauge");
+            out << entry.name << formatLabels(entry.labels) << " " << entry.metric->get() << "\n";
+        }
+        for (const auto &entry : callbacks)
+        {
+            header(entry.name, entry.help, "gauge");
+            out << entry.name << " " << (*entry.metric)() << "\n";
+        }
+        for (const auto &entry : histograms)
+        {
+            header(entry.name, entry.help, "histogram");
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < Histogram::bounds.size(); ++i)
+            {
+                cumulative += entry.metric->bucketCount(i);
+                MetricLabels labels = entry.labels;
+                std::ostringstream le;
+                le << Histogram::bounds[i];
+                labels["le"] = le.str();
+                out << entry.name << "_bucket" << formatLabels(labels) << " " << cumulative << "\n";
+            }
+            MetricLabels labels = entry.labels;
+            labels["le"] = "+Inf";
+            out << entry.name << "_bucket" << formatLabels(labels) << " " << entry.metric->totalCount() << "\n";
+            out << entry.name << "_sum" << formatLabels(entry.labels) << " " << entry.metric->sum() << "\n";
+            out << entry.name << "_count" << formatLabels(entry.labels) << " " << entry.metric->totalCount() << "\n";
+        }
+        return out.str();
+    }
+
+private:
+    template <typename T>
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        MetricLabels labels;
+        std::unique_ptr<T> metric;
+    };
+
+    // Inserts `entry` after the last entry of the same name, so that every
+    // series of a metric family renders under one HELP/TYPE header whatever
+    // order they were registered in.
+    template <typename T>
+    static std::unique_ptr<T> &add(std::vector<Entry<T>> &entries, Entry<T> entry)
+    {
+        auto sameName = std::find_if(entries.rbegin(), entries.rend(), [&](const Entry<T> &existing)
+                                     { return existing.name == entry.name; });
+        auto position = sameName == entries.rend() ? entries.end() : sameName.base();
+        return entries.insert(position, std::move(entry))->metric;
+    }
+
+    static std::string formatLabels(const MetricLabels &labels)
+    {
+        if (labels.empty())
+        {
+            return "";
+        }
+        std::string result = "{";
+        for (const auto &[key, value] : labels)
+        {
+            if (result.size() > 1)
+            {
+                result += ",";
+            }
+            result += key + "=\"" + value + "\"";
+        }
+        return result + "}";
+    }
+
+    mutable std::mutex mutex;
+    std::vector<Entry<Counter>> counters;
+    std::vector<Entry<Gauge>> gauges;
+    std::vector<Entry<Histogram>> histograms;
+    std::vector<Entry<std::function<double()>>> callbacks;
+};
+
+inline MetricsRegistry &metrics()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+// Resident set size of this process, read from /proc.
+inline double residentMemoryBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0;
+    long residentPages = 0;
+    statm >> pages >> residentPages;
+    return static_cast<double>(residentPages) * sysconf(_SC_PAGESIZE);
+}
+
+// Serves metrics().render() on GET requests to any path of the given port,
+// bound to `address` (loopback unless configured otherwise). Each scrape gets
+// its own thread and must send its request and read the response within
+// metricsScrapeTimeout, so an idle or slow connection cannot block others.
+constexpr std::chrono::seconds metricsScrapeTimeout(5);
+
+// One scrape connection; the socket is declared after, and so closed before,
+// the io_context it runs on.
+struct MetricsScrape
+{
+    asio::io_context context;
+    asio::ip::tcp::socket socket{context};
+};
+
+inline void serveMetricsScrape(std::unique_ptr<MetricsScrape> scrape)
+{
+    asio::streambuf request(8192);
+    std::string response;
+    asio::async_read_until(scrape->socket, request, "\r\n\r\n", [&](const auto &error, size_t)
+                           {
+        if (error)
+        {
+            return;
+        }
+        std::string body = metrics().render();
+        response = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " +
+                   std::to_string(body.size()) + "\r\n\r\n" + body;
+        asio::async_write(scrape->socket, asio::buffer(response), [](const auto &, size_t) {}); });
+    scrape->context.run_for(metricsScrapeTimeout);
+}
+
+inline void startMetricsServer(unsigned short port, const std::string &address = "127.0.0.1")
+{
+    metrics().callbackGauge("process_resident_memory_bytes", "Resident memory size in bytes.", residentMemoryBytes);
+
+    std::thread([port, address]()
+                {
+        try
+        {
+            asio::io_context io_context;
+            asio::ip::tcp::acceptor acceptor(io_context, asio::ip::tcp::endpoint(asio::ip::make_address(address), port));
+            while (true)
+            {
+                auto scrape = std::make_unique<MetricsScrape>();
+                acceptor.accept(scrape->socket);
+                std::thread(serveMetricsScrape, std::move(scrape)).detach();
+            }
+        }
+        catch (const std::exception &e)
+        {
+            logError("Exception in metrics server: ", e.what());
+        } })
+        .detach();
+}
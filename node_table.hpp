@@ -0,0 +1,144 @@
+#pragma once
+
+// Typed membership table of the registry.
+//
+// Nodes are stored once, keyed by Ip, with a secondary index from nodeType to
+// that type's nodes ordered by computingCapacity, maintained on every change.
+// Lookups by Ip and picking the highest-capacity nodes of a type are therefore
+// O(log n) (plus the size of the answer) instead of a scan over JSON objects.
+// Not thread-safe; the registry guards it with a reader-writer lock.
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "json.hpp"
+
+struct NodeRecord
+{
+    std::string ip;
+    std::string nodeType;
+    double computingCapacity = 0.0;
+    std::chrono::steady_clock::time_point expiresAt; // Lease deadline
+
+    // Registration and heartbeat messages carry the same three fields.
+    static NodeRecord fromJson(const nlohmann::json &message)
+    {
+        NodeRecord record;
+        record.ip = message.at("Ip").get<std::string>();
+        record.nodeType = message.at("nodeType").get<std::string>();
+        record.computingCapacity = message.at("computingCapacity").get<double>();
+        return record;
+    }
+
+    nlohmann::json toJson() const
+    {
+        return {{"Ip", ip}, {"nodeType", nodeType}, {"computingCapacity", computingCapacity}};
+    }
+
+    bool sameAs(const NodeRecord &other) const
+    {
+        return ip == other.ip && nodeType == other.nodeType && computingCapacity == other.computingCapacity;
+    }
+};
+
+class NodeTable
+{
+public:
+    enum class Upsert
+    {
+        Added,
+        Updated, // Type or capacity changed
+        Renewed  // Only the lease changed
+    };
+
+    Upsert upsert(const NodeRecord &record)
+    {
+        auto it = byIp.find(record.ip);
+        if (it == byIp.end())
+        {
+            byIp.emplace(record.ip, record);
+            index(record);
+            return Upsert::Added;
+        }
+        bool changed = !it->second.sameAs(record);
+        if (changed)
+        {
+            unindex(it->second);
+            index(record);
+        }
+        it->second = record;
+        return changed ? Upsert::Updated : Upsert::Renewed;
+    }
+
+    std::optional<NodeRecord> erase(const std::string &ip)
+    {
+        auto it = byIp.find(ip);
+        if (it == byIp.end())
+        {
+            return std::nullopt;
+        }
+        NodeRecord removed = std::move(it->second);
+        byIp.erase(it);
+        unindex(removed);
+        return removed;
+    }
+
+    const NodeRecord *find(const std::string &ip) const
+    {
+        auto it = byIp.find(ip);
+        return it == byIp.end() ? nullptr : &it->second;
+    }
+
+    // Up to `limit` nodes of `nodeType` with the highest computingCapacity, best first.
+    std::vector<const NodeRecord *> topByCapacity(const std::string &nodeType, size_t limit) const
+    {
+        std::vector<const NodeRecord *> nodes;
+        auto it = capacityByType.find(nodeType);
+        if (it != capacityByType.end())
+        {
+            for (auto entry = it->second.begin(); entry != it->second.end() && nodes.size() < limit; ++entry)
+            {
+                nodes.push_back(&byIp.at(entry->second));
+            }
+        }
+        return nodes;
+    }
+
+    // Visits every node, ordered by Ip.
+    template <typename Visitor>
+    void forEach(Visitor visitor) const
+    {
+        for (const auto &[ip, record] : byIp)
+        {
+            visitor(record);
+        }
+    }
+
+    size_t size() const { return byIp.size(); }
+
+private:
+    using CapacityOrder = std::set<std::pair<double, std::string>, std::greater<>>;
+
+    void index(const NodeRecord &record)
+    {
+        capacityByType[record.nodeType].emplace(record.computingCapacity, record.ip);
+    }
+
+    void unindex(const NodeRecord &record)
+    {
+        auto capacities = capacityByType.find(record.nodeType);
+        capacities->second.erase({record.computingCapacity, record.ip});
+        if (capacities->second.empty())
+        {
+            capacityByType.erase(capacities);
+        }
+    }
+
+    std::map<std::string, NodeRecord> byIp;
+    std::map<std::string, CapacityOrder> capacityByType;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+// Cache of query results keyed by the query spec and the store version.
+//
+// The store bumps its version on every ingest; an entry is only served while
+// the version it was computed at is still current, so repeated dashboard polls
+// between ingests skip the scan entirely. Entries from older versions are
+// overwritten in place, and the cache is cleared when it reaches its entry
+// count or byte capacity. Sizes are the serialized key and result, so a large
+// result (such as one with "includeSketches") counts for what it holds; one
+// above a sixteenth of the byte capacity is not cached at all.
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "json.hpp"
+
+class QueryCache
+{
+public:
+    explicit QueryCache(size_t capacity = 1024, size_t byteCapacity = size_t(64) << 20)
+        : capacity(capacity), byteCapacity(byteCapacity) {}
+
+    bool lookup(const std::string &key, uint64_t version, nlohmann::json &result) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end() || it->second.version != version)
+        {
+            return false;
+        }
+        result = it->second.result;
+        return true;
+    }
+
+    void insert(const std::string &key, uint64_t version, const nlohmann::json &result)
+    {
+        size_t size = key.size() + result.dump().size();
+        if (size > byteCapacity / 16)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            bytes -= it->second.size;
+        }
+        else if (entries.size() >= capacity)
+        {
+            entries.clear();
+            bytes = 0;
+        }
+        if (bytes + size > byteCapacity)
+        {
+            entries.clear();
+            bytes = 0;
+        }
+        entries[key] = {version, result, size};
+        bytes += size;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t version;
+        nlohmann::json result;
+        size_t size; // Serialized key and result
+    };
+
+    const size_t capacity;
+    const size_t byteCapacity;
+    size_t bytes = 0;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+};
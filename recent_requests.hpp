@@ -0,0 +1,105 @@
+#pragma once
+
+// Bounded table of recent ingest requests, for idempotent retries.
+//
+// Keyed by request type and requestID, so a retry is recognized however the
+// client re-serialized it, including while the first attempt is still being
+// handled. Each entry also carries a fingerprint of the payload: a restarted
+// client that reuses requestID 1 for new data does not match, and replaces
+// the entry. Only acknowledgments are remembered (query results are already
+// in the QueryCache); they are a few dozen bytes each, so the oldest entry is
+// evicted once `capacity` requests are remembered and memory stays bounded.
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include "json.hpp"
+
+class RecentRequests
+{
+public:
+    enum class Status
+    {
+        New,        // Not seen; handle it and then call complete() or abandon()
+        InProgress, // The same request is being handled by another thread
+        Answered    // Already handled; `reply` holds the acknowledgment that was sent
+    };
+
+    explicit RecentRequests(size_t capacity = 4096) : capacity(capacity) {}
+
+    static uint64_t key(uint8_t requestType, int64_t requestId)
+    {
+        return static_cast<uint64_t>(requestType) << 56 ^ static_cast<uint64_t>(requestId);
+    }
+
+    Status begin(uint64_t key, uint64_t fingerprint, nlohmann::json &reply)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto [it, inserted] = entries.try_emplace(key);
+        Entry &entry = it->second;
+        if (inserted)
+        {
+            order.push_back(key);
+            if (order.size() > capacity)
+            {
+                entries.erase(order.front());
+                order.pop_front();
+            }
+        }
+        else if (entry.state != State::Abandoned && entry.fingerprint == fingerprint)
+        {
+            if (entry.state == State::InProgress)
+            {
+                return Status::InProgress;
+            }
+            reply = entry.reply;
+            return Status::Answered;
+        }
+        // New, abandoned, or a different payload under a reused requestID
+        entry = {fingerprint, State::InProgress, nullptr};
+        return Status::New;
+    }
+
+    void complete(uint64_t key, uint64_t fingerprint, const nlohmann::json &reply)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.fingerprint == fingerprint && it->second.state == State::InProgress)
+        {
+            it->second.state = State::Answered;
+            it->second.reply = reply;
+        }
+    }
+
+    // Forgets a request whose handling failed, so a retry is handled afresh.
+    void abandon(uint64_t key, uint64_t fingerprint)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.fingerprint == fingerprint && it->second.state == State::InProgress)
+        {
+            it->second.state = State::Abandoned;
+        }
+    }
+
+private:
+    enum class State
+    {
+        InProgress,
+        Answered,
+        Abandoned
+    };
+
+    struct Entry
+    {
+        uint64_t fingerprint = 0;
+        State state = State::InProgress;
+        nlohmann::json reply;
+    };
+
+    const size_t capacity;
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    std::deque<uint64_t> order; // Insertion order, oldest first
+};
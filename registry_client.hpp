@@ -0,0 +1,158 @@
+#pragma once
+
+// A node's connection to the registry: registration, lease heartbeats and an
+// in-process copy of the cluster topology.
+//
+// start() returns immediately; a background thread registers the node,
+// retrying with exponential backoff and jitter until the registry answers, and
+// applies the "Node Discovery" reply to the topology. It then keeps the lease
+// alive with heartbeats while a membership subscription pushes topology
+// deltas. Nodes and registry can therefore start in any order. Routing code
+// reads topology() without a registry round trip. If measureCapacity is set,
+// each heartbeat reports its current value as the node's computingCapacity.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <asio.hpp>
+#include "json.hpp"
+#include "logger.hpp"
+#include "membership.hpp"
+
+struct RegistryClientOptions
+{
+    std::string registryIp;
+    unsigned short registryPort = 12345;
+    std::string nodeIp;
+    std::string nodeType = "analytics";
+    double computingCapacity = 0.6; // Reported at registration
+    std::chrono::milliseconds heartbeatInterval{3000}; // Registry lease is 10 s
+    std::function<double()> measureCapacity;           // Sampled before each heartbeat
+};
+
+class RegistryClient
+{
+public:
+    void start(RegistryClientOptions clientOptions)
+    {
+        options = std::move(clientOptions);
+        computingCapacity = options.computingCapacity;
+        std::thread([this]()
+                    {
+            registerWithBackoff();
+            std::thread(followMembership, options.registryIp, options.registryPort, std::ref(view)).detach();
+            sendHeartbeats(); })
+            .detach();
+    }
+
+    bool registered() const { return isRegistered.load(std::memory_order_acquire); }
+
+    const MembershipView &topology() const { return view; }
+
+private:
+    nlohmann::json nodeMessage(const char *requestType) const
+    {
+        return {
+            {"requestType", requestType},
+            {"Ip", options.nodeIp},
+            {"nodeType", options.nodeType},
+            {"computingCapacity", computingCapacity}};
+    }
+
+    // Sends the registration and caches the topology from the reply.
+    bool registerNode()
+    {
+        using asio::ip::tcp;
+        try
+        {
+            asio::io_context io_context;
+            tcp::resolver resolver(io_context);
+            tcp::socket socket(io_context);
+            asio::connect(socket, resolver.resolve(options.registryIp, std::to_string(options.registryPort)));
+
+            std::string message = nodeMessage("registering").dump() + "\n";
+            asio::write(socket, asio::buffer(message));
+            logInfo("Sent registration request to registry server");
+
+            asio::streambuf buffer;
+            asio::read_until(socket, buffer, "\n");
+            std::istream is(&buffer);
+            std::string reply;
+            std::getline(is, reply);
+            view.apply(nlohmann::json::parse(reply));
+            logInfo("Registered with registry: ", view.nodes().size(), " nodes at membership version ", view.version());
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            logError("Registration with registry failed: ", e.what());
+            return false;
+        }
+    }
+
+    // Retries every 0.1 s at first, doubling up to 10 s. Each wait is jittered
+    // between half and all of the current delay so restarted nodes do not
+    // retry in lockstep.
+    void registerWithBackoff()
+    {
+        std::mt19937 rng(std::random_device{}());
+        std::chrono::milliseconds delay(100);
+        for (int attempt = 1; !registerNode(); ++attempt)
+        {
+            std::uniform_int_distribution<long long> jitter(delay.count() / 2, delay.count());
+            std::chrono::milliseconds wait(jitter(rng));
+            logInfo("Retrying registration in ", wait.count(), " ms (attempt ", attempt + 1, ")");
+            std::this_thread::sleep_for(wait);
+            delay = std::min<std::chrono::milliseconds>(delay * 2, std::chrono::seconds(10));
+        }
+        isRegistered.store(true, std::memory_order_release);
+    }
+
+    // Renews the lease until the process exits. Heartbeats carry the
+    // registration fields, so a registry that lost the node re-admits it.
+    void sendHeartbeats()
+    {
+        using asio::ip::tcp;
+        RateLimiter failureLogLimiter(1);
+        while (true)
+        {
+            std::this_thread::sleep_for(options.heartbeatInterval);
+            if (options.measureCapacity)
+            {
+                double measured = options.measureCapacity();
+                if (measured != computingCapacity)
+                {
+                    logInfo("Computing capacity now ", measured);
+                    computingCapacity = measured;
+                }
+            }
+            std::string message = nodeMessage("heartbeat").dump() + "\n";
+            try
+            {
+                asio::io_context io_context;
+                tcp::resolver resolver(io_context);
+                tcp::socket socket(io_context);
+                asio::connect(socket, resolver.resolve(options.registryIp, std::to_string(options.registryPort)));
+                asio::write(socket, asio::buffer(message));
+                socket.close();
+            }
+            catch (const std::exception &e)
+            {
+                if (failureLogLimiter.allow())
+                {
+                    logWarn("Heartbeat to registry failed: ", e.what());
+                }
+            }
+        }
+    }
+
+    RegistryClientOptions options;
+    MembershipView view;
+    std::atomic<bool> isRegistered{false};
+    double computingCapacity = 0; // Written before heartbeats start, then only by the heartbeat thread
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+// On-disk membership state of the registry.
+//
+// Two files in the state directory: registry.snapshot holds a full "Node
+// Discovery" snapshot (nodes, leaders, epoch and version), and registry.log
+// appends one JSON line per membership change after it. Heartbeats that only
+// renew a lease are not logged, so the log grows with changes, not traffic.
+// A snapshot is written to a temporary file and renamed over the old one before
+// the log is truncated; on load, logged changes at or below the snapshot's
+// version (left over from a crash between the two) and lines that are not
+// JSON (such as a torn last line) are skipped. Entries are returned as parsed;
+// the registry skips any whose fields are missing or mistyped.
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+class RegistryJournal
+{
+public:
+    struct State
+    {
+        nlohmann::json snapshot;              // null if there is none
+        std::vector<nlohmann::json> changes;  // Logged after the snapshot, oldest first
+        size_t unreadableLines = 0;           // Log lines that are not JSON
+    };
+
+    explicit RegistryJournal(const std::string &directory)
+        : snapshotPath(directory + "/registry.snapshot"), logPath(directory + "/registry.log") {}
+
+    State load() const
+    {
+        State state;
+        std::ifstream snapshotFile(snapshotPath);
+        if (snapshotFile)
+        {
+            state.snapshot = nlohmann::json::parse(snapshotFile, nullptr, false);
+            if (state.snapshot.is_discarded())
+            {
+                state.snapshot = nullptr;
+            }
+        }
+        if (!state.snapshot.is_object())
+        {
+            state.snapshot = nullptr;
+        }
+        uint64_t snapshotVersion = versionOf(state.snapshot);
+
+        std::ifstream logFile(logPath);
+        std::string line;
+        while (std::getline(logFile, line))
+        {
+            nlohmann::json change = nlohmann::json::parse(line, nullptr, false);
+            if (change.is_discarded())
+            {
+                ++state.unreadableLines; // A torn write at the end of the log, or a damaged line
+                continue;
+            }
+            if (versionOf(change) > snapshotVersion)
+            {
+                state.changes.push_back(std::move(change));
+            }
+        }
+        return state;
+    }
+
+    // Appends one change and flushes it to the operating system.
+    void append(const nlohmann::json &change)
+    {
+        if (!log.is_open())
+        {
+            log.open(logPath, std::ios::app);
+        }
+        log << change.dump() << '\n';
+        log.flush();
+        ++entries;
+    }
+
+    // Replaces the snapshot and starts an empty log.
+    bool writeSnapshot(const nlohmann::json &snapshot)
+    {
+        std::string temporaryPath = snapshotPath + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::trunc);
+            file << snapshot.dump() << '\n';
+            if (!file.flush())
+            {
+                return false;
+            }
+        }
+        if (std::rename(temporaryPath.c_str(), snapshotPath.c_str()) != 0)
+        {
+            return false;
+        }
+        log.close();
+        log.open(logPath, std::ios::trunc);
+        entries = 0;
+        return true;
+    }
+
+    size_t entriesSinceSnapshot() const { return entries; }
+
+private:
+    // The "version" of a snapshot or change, or 0 if it has none.
+    static uint64_t versionOf(const nlohmann::json &entry)
+    {
+        if (!entry.is_object())
+        {
+            return 0;
+        }
+        auto version = entry.find("version");
+        return version != entry.end() && version->is_number_unsigned() ? version->get<uint64_t>() : 0;
+    }
+
+    const std::string snapshotPath;
+    const std::string logPath;
+    std::ofstream log;
+    size_t entries = 0;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+// Request types understood by analytics nodes and the registry.
+//
+// A message's "requestType" string is resolved once into a RequestType with a
+// perfect hash over the known names: (length + first byte) mod 16 picks a slot
+// in a table built at compile time, and one string compare against that
+// slot's name confirms the match. A static_assert fails the build if a new
+// name collides, in which case the hash or slot count needs adjusting.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class RequestType : uint8_t
+{
+    InitAnalytics,
+    Analytics,
+    BulkLoad,
+    Query,
+    Registering, // Registry: node registration
+    Heartbeat,   // Registry: lease renewal
+    Lookup,      // Registry: node lookup by Ip or type
+    Subscribe,   // Registry: membership update stream
+    Unknown      // Also the number of known types
+};
+
+constexpr size_t requestTypeCount = static_cast<size_t>(RequestType::Unknown);
+
+// Wire names, indexed by RequestType.
+constexpr std::array<std::string_view, requestTypeCount> requestTypeNames = {
+    "Init Analytics", "analytics", "bulk load", "query", "registering", "heartbeat", "lookup", "subscribe"};
+
+constexpr size_t requestTypeSlots = 16;
+
+constexpr size_t requestTypeSlot(std::string_view name)
+{
+    return (name.size() + static_cast<unsigned char>(name[0])) % requestTypeSlots;
+}
+
+constexpr std::array<RequestType, requestTypeSlots> buildRequestTypeTable()
+{
+    std::array<RequestType, requestTypeSlots> table{};
+    for (auto &slot : table)
+    {
+        slot = RequestType::Unknown;
+    }
+    for (size_t type = 0; type < requestTypeCount; ++type)
+    {
+        table[requestTypeSlot(requestTypeNames[type])] = static_cast<RequestType>(type);
+    }
+    return table;
+}
+
+constexpr std::array<RequestType, requestTypeSlots> requestTypeTable = buildRequestTypeTable();
+
+constexpr bool requestTypeHashIsPerfect()
+{
+    for (size_t type = 0; type < requestTypeCount; ++type)
+    {
+        if (requestTypeTable[requestTypeSlot(requestTypeNames[type])] != static_cast<RequestType>(type))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(requestTypeHashIsPerfect(), "requestType names collide in requestTypeTable");
+
+constexpr RequestType parseRequestType(std::string_view name)
+{
+    if (name.empty())
+    {
+        return RequestType::Unknown;
+    }
+    RequestType type = requestTypeTable[requestTypeSlot(name)];
+    return type != RequestType::Unknown && requestTypeNames[static_cast<size_t>(type)] == name ? type : RequestType::Unknown;
+}
+
+constexpr std::string_view requestTypeName(RequestType type)
+{
+    return type == RequestType::Unknown ? "invalid" : requestTypeNames[static_cast<size_t>(type)];
+}
+
+static_assert(parseRequestType("bulk load") == RequestType::BulkLoad && parseRequestType("bulk loaf") == RequestType::Unknown);
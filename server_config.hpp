@@ -0,0 +1,188 @@
+#pragma once
+
+// Endpoints and settings of a server process.
+//
+// Each binary starts from its own defaults, then applies a JSON config file
+// (--config FILE) and finally command-line flags, so later sources win:
+//   {"ip": "192.168.1.3", "port": 12346, "nodeType": "analytics",
+//    "registryIp": "10.0.0.65", "registryPort": 12345,
+//    "replyIp": "10.0.0.65", "ackPort": 12458, "responsePort": 12460,
+//    "heartbeatMs": 3000, "dataDir": "data", "metricsAddress": "127.0.0.1",
+//    "metricsPort": 13346}
+// Every key is optional; the matching flags are --ip, --port, --node-type,
+// --registry-ip, --registry-port, --reply-ip, --ack-port, --response-port,
+// --heartbeat-ms, --data-dir, --metrics-address and --metrics-port. Anything
+// that is not a flag is kept, in order, in `arguments`. Bad input, such as a
+// port outside 1-65535 or a non-numeric value, throws std::invalid_argument
+// naming the setting.
+
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+// Without a metricsPort setting, metrics are served on the listening port plus this offset.
+constexpr unsigned short metricsPortOffset = 1000;
+
+struct ServerConfig
+{
+    std::string nodeIp;                  // Advertised to the registry
+    unsigned short port = 0;             // Listening port
+    std::string nodeType = "analytics";
+    std::string registryIp = "127.0.0.1";
+    unsigned short registryPort = 12345;
+    std::string replyIp = "127.0.0.1";   // Receiver of acknowledgments and query responses
+    unsigned short ackPort = 12458;
+    unsigned short responsePort = 12460;
+    std::chrono::milliseconds heartbeatInterval{3000};
+    std::string dataDir = "data";        // "bulk load" paths are resolved inside it and may not leave it
+    std::string metricsAddress = "127.0.0.1"; // Interface the metrics endpoint binds to
+    unsigned short metricsPort = 0;      // Metrics endpoint port; 0 means port + metricsPortOffset
+    std::vector<std::string> arguments;  // Positional command-line arguments
+
+    static ServerConfig parse(int argc, char *argv[], ServerConfig config)
+    {
+        for (int i = 1; i + 1 < argc; ++i)
+        {
+            if (std::string(argv[i]) == "--config")
+            {
+                config.merge(readFile(argv[i + 1]));
+            }
+        }
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string flag = argv[i];
+            if (flag.rfind("--", 0) != 0)
+            {
+                config.arguments.push_back(flag);
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for " + flag);
+            }
+            std::string value = argv[++i];
+            if (flag == "--config")
+                continue;
+            else if (flag == "--ip")
+                config.nodeIp = value;
+            else if (flag == "--port")
+                config.port = parsePort(value, "--port");
+            else if (flag == "--node-type")
+                config.nodeType = value;
+            else if (flag == "--registry-ip")
+                config.registryIp = value;
+            else if (flag == "--registry-port")
+                config.registryPort = parsePort(value, "--registry-port");
+            else if (flag == "--reply-ip")
+                config.replyIp = value;
+            else if (flag == "--ack-port")
+                config.ackPort = parsePort(value, "--ack-port");
+            else if (flag == "--response-port")
+                config.responsePort = parsePort(value, "--response-port");
+            else if (flag == "--heartbeat-ms")
+                config.heartbeatInterval = std::chrono::milliseconds(parseNumber(value, "--heartbeat-ms", 1, 3600000));
+            else if (flag == "--data-dir")
+                config.dataDir = value;
+            else if (flag == "--metrics-address")
+                config.metricsAddress = value;
+            else if (flag == "--metrics-port")
+                config.metricsPort = parsePort(value, "--metrics-port");
+            else
+                throw std::invalid_argument("Unknown option " + flag);
+        }
+        return config;
+    }
+
+    void merge(const nlohmann::json &file)
+    {
+        nodeIp = file.value("ip", nodeIp);
+        port = static_cast<unsigned short>(numberSetting(file, "port", port, 1, 65535));
+        nodeType = file.value("nodeType", nodeType);
+        registryIp = file.value("registryIp", registryIp);
+        registryPort = static_cast<unsigned short>(numberSetting(file, "registryPort", registryPort, 1, 65535));
+        replyIp = file.value("replyIp", replyIp);
+        ackPort = static_cast<unsigned short>(numberSetting(file, "ackPort", ackPort, 1, 65535));
+        responsePort = static_cast<unsigned short>(numberSetting(file, "responsePort", responsePort, 1, 65535));
+        heartbeatInterval = std::chrono::milliseconds(numberSetting(file, "heartbeatMs", heartbeatInterval.count(), 1, 3600000));
+        dataDir = file.value("dataDir", dataDir);
+        metricsAddress = file.value("metricsAddress", metricsAddress);
+        metricsPort = static_cast<unsigned short>(numberSetting(file, "metricsPort", metricsPort, 1, 65535));
+    }
+
+    // The metrics endpoint's port: metricsPort, or port + metricsPortOffset.
+    // Throws std::invalid_argument if the latter would pass 65535.
+    unsigned short resolvedMetricsPort() const
+    {
+        if (metricsPort != 0)
+        {
+            return metricsPort;
+        }
+        if (port > 65535 - metricsPortOffset)
+        {
+            throw std::invalid_argument("Invalid port " + std::to_string(port) + ": metrics would be served on port + " +
+                                        std::to_string(metricsPortOffset) + ", past 65535; set metricsPort (--metrics-port)");
+        }
+        return static_cast<unsigned short>(port + metricsPortOffset);
+    }
+
+    // Parses the value of `setting` as a port, 1-65535.
+    static unsigned short parsePort(const std::string &value, const std::string &setting)
+    {
+        return static_cast<unsigned short>(parseNumber(value, setting, 1, 65535));
+    }
+
+private:
+    static long long parseNumber(const std::string &value, const std::string &setting, long long min, long long max)
+    {
+        size_t end = 0;
+        long long number = 0;
+        try
+        {
+            number = std::stoll(value, &end);
+        }
+        catch (const std::logic_error &)
+        {
+            end = 0;
+        }
+        if (end == 0 || end != value.size() || number < min || number > max)
+        {
+            throw std::invalid_argument("Invalid " + setting + " \"" + value + "\": expected a number from " +
+                                        std::to_string(min) + " to " + std::to_string(max));
+        }
+        return number;
+    }
+
+    // A numeric setting of the config file, or `current` if it is absent.
+    static long long numberSetting(const nlohmann::json &file, const char *key, long long current, long long min, long long max)
+    {
+        auto it = file.find(key);
+        if (it == file.end())
+        {
+            return current;
+        }
+        if (!it->is_number_integer() || it->get<long long>() < min || it->get<long long>() > max)
+        {
+            throw std::invalid_argument(std::string("Invalid ") + key + " " + it->dump() + " in config file: expected a number from " +
+                                        std::to_string(min) + " to " + std::to_string(max));
+        }
+        return it->get<long long>();
+    }
+
+    static nlohmann::json readFile(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::invalid_argument("Cannot open config file " + path);
+        }
+        nlohmann::json config = nlohmann::json::parse(file, nullptr, false);
+        if (!config.is_object())
+        {
+            throw std::invalid_argument("Config file " + path + " is not a JSON object");
+        }
+        return config;
+    }
+};
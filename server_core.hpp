@@ -0,0 +1,235 @@
+#pragma once
+
+// Shared core of the analytics node binaries.
+//
+// ServerCore accepts connections (one thread each), reads one message per
+// connection (plain JSON line or compressed frame), resolves its
+// "requestType" once to a RequestType and dispatches it to the handler the
+// binary registered for that type with on(); types without a handler are
+// counted as invalid. It also sends replies to the configured
+// acknowledgment/response receiver, serves metrics, and runs the registry
+// client that registers the node and reports its measured capacity. A binary
+// is its defaults plus the handlers it registers; see runNode().
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <asio.hpp>
+#include "json.hpp"
+#include "capacity_estimator.hpp"
+#include "logger.hpp"
+#include "message_codec.hpp"
+#include "metrics.hpp"
+#include "registry_client.hpp"
+#include "request_type.hpp"
+#include "server_config.hpp"
+
+struct ServerMetrics
+{
+    Counter &invalidMessages = metrics().counter("analytics_messages_total", "Messages received by request type.", {{"requestType", "invalid"}});
+    Counter &bytesIn = metrics().counter("analytics_bytes_in_total", "Bytes of request messages received.");
+    Counter &bytesOut = metrics().counter("analytics_bytes_out_total", "Bytes of acknowledgments and query responses sent.");
+    Counter &ingestedRows = metrics().counter("analytics_ingested_rows_total", "Rows ingested from analytics requests.");
+    Counter &duplicateRows = metrics().counter("analytics_duplicate_rows_total", "Re-sent rows dropped by the deduplication index.");
+    Counter &malformedRows = metrics().counter("analytics_rejected_rows_total", "Rows that were not stored, by reason.", {{"reason", "malformed"}});
+    Counter &dictionaryFullRows = metrics().counter("analytics_rejected_rows_total", "Rows that were not stored, by reason.", {{"reason", "dictionary full"}});
+    Gauge &storedRows = metrics().gauge("analytics_stored_rows", "Rows currently held in the store.");
+    Gauge &activeConnections = metrics().gauge("analytics_active_connections", "Client connections currently being handled (queue depth).");
+    Counter &duplicateRequests = metrics().counter("analytics_duplicate_requests_total", "Retried requests answered from the recent-request table.");
+    Counter &queryCacheHits = metrics().counter("analytics_query_cache_hits_total", "Queries answered from the result cache.");
+    Counter &queryCacheMisses = metrics().counter("analytics_query_cache_misses_total", "Queries evaluated against the store.");
+    Histogram &parseSeconds = metrics().histogram("analytics_parse_seconds", "Time spent parsing request JSON.");
+    Histogram &ingestSeconds = metrics().histogram("analytics_ingest_seconds", "Time spent ingesting the rows of an analytics request.");
+    Histogram &querySeconds = metrics().histogram("analytics_query_seconds", "Time spent computing query results.");
+    Histogram &ackSendSeconds = metrics().histogram("analytics_ack_send_seconds", "Time spent connecting and sending acknowledgments and query responses.");
+};
+
+inline ServerMetrics &serverMetrics()
+{
+    static ServerMetrics instance;
+    return instance;
+}
+
+class ServerCore
+{
+public:
+    // Called with the parsed message and the raw text it was parsed from.
+    using Handler = std::function<void(const nlohmann::json &message, const std::string &raw)>;
+
+    explicit ServerCore(ServerConfig config)
+        : settings(std::move(config)), replyCompression(CompressionPolicy::fromEnvironment()) {}
+
+    // Routes messages of `type` to `handler`. Register before run().
+    void on(RequestType type, Handler handler)
+    {
+        Route &route = routes[static_cast<size_t>(type)];
+        if (!route.messages)
+        {
+            route.messages = &metrics().counter("analytics_messages_total", "Messages received by request type.", {{"requestType", std::string(requestTypeName(type))}});
+        }
+        route.handler = std::move(handler);
+    }
+
+    void sendAcknowledgment(const nlohmann::json &acknowledgment) { sendReply(acknowledgment, settings.ackPort); }
+    void sendQueryResponse(const nlohmann::json &queryResponse) { sendReply(queryResponse, settings.responsePort); }
+
+    const ServerConfig &config() const { return settings; }
+    const MembershipView &topology() const { return registryClient.topology(); }
+
+    // Serves until the process exits. Connections are accepted before the node
+    // is registered; registration retries in the background.
+    void run()
+    {
+        serverMetrics();
+        startMetricsServer(settings.resolvedMetricsPort(), settings.metricsAddress);
+
+        try
+        {
+            asio::io_context io_context;
+            asio::ip::tcp::acceptor acceptor(io_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), settings.port));
+            std::thread serverThread([this, &io_context, &acceptor]()
+                                     { acceptConnections(io_context, acceptor); });
+
+            CapacityEstimator capacity(serverMetrics().activeConnections, {&serverMetrics().ingestSeconds, &serverMetrics().querySeconds});
+            registryClient.start({settings.registryIp, settings.registryPort, settings.nodeIp, settings.nodeType, capacity.sample(), settings.heartbeatInterval, [&capacity]()
+                                  { return capacity.sample(); }});
+
+            serverThread.join();
+        }
+        catch (const std::exception &e)
+        {
+            logError("Exception in server: ", e.what());
+        }
+    }
+
+private:
+    struct Route
+    {
+        Handler handler;
+        Counter *messages = nullptr;
+    };
+
+    void acceptConnections(asio::io_context &io_context, asio::ip::tcp::acceptor &acceptor)
+    {
+        while (true)
+        {
+            asio::ip::tcp::socket socket(io_context);
+            acceptor.accept(socket);
+            logDebug("Accepted connection from: ", socket.remote_endpoint());
+            std::thread(&ServerCore::handleClient, this, std::move(socket)).detach();
+        }
+    }
+
+    void handleClient(asio::ip::tcp::socket socket)
+    {
+        serverMetrics().activeConnections.add(1);
+        try
+        {
+            // Plain JSON line or compressed frame; bytesIn counts what crossed the wire
+            size_t wireBytes = 0;
+            std::string message = readMessage(socket, wireBytes);
+            serverMetrics().bytesIn.inc(wireBytes);
+            logDebug("Received message: ", message);
+
+            dispatch(message);
+
+            socket.close();
+        }
+        catch (const std::exception &e)
+        {
+            logError("Exception in client handling: ", e.what());
+        }
+        serverMetrics().activeConnections.add(-1);
+    }
+
+    void dispatch(const std::string &message)
+    {
+        try
+        {
+            nlohmann::json request;
+            {
+                ScopedTimer timer(serverMetrics().parseSeconds);
+                request = nlohmann::json::parse(message);
+            }
+
+            auto requestType = request.find("requestType");
+            RequestType type = requestType != request.end() && requestType->is_string() ? parseRequestType(requestType->get_ref<const std::string &>()) : RequestType::Unknown;
+            if (type == RequestType::Unknown || !routes[static_cast<size_t>(type)].handler)
+            {
+                serverMetrics().invalidMessages.inc();
+                logWarn("Invalid request type: ", requestType != request.end() ? requestType->dump() : "none");
+                return;
+            }
+            Route &route = routes[static_cast<size_t>(type)];
+            route.messages->inc();
+            route.handler(request, message);
+        }
+        catch (const nlohmann::json::exception &e)
+        {
+            logError("JSON Exception: ", e.what());
+        }
+        catch (const std::runtime_error &e)
+        {
+            logError("Runtime Error: ", e.what());
+        }
+    }
+
+    void sendReply(const nlohmann::json &reply, unsigned short port)
+    {
+        ScopedTimer timer(serverMetrics().ackSendSeconds);
+        asio::io_context io_context;
+        asio::ip::tcp::resolver resolver(io_context);
+        asio::ip::tcp::socket socket(io_context);
+        asio::connect(socket, resolver.resolve(settings.replyIp, std::to_string(port)));
+
+        std::string encoded = encodeMessage(reply.dump(), replyCompression);
+        asio::write(socket, asio::buffer(encoded));
+        serverMetrics().bytesOut.inc(encoded.size());
+
+        socket.close();
+    }
+
+    const ServerConfig settings;
+    const CompressionPolicy replyCompression;
+    std::array<Route, requestTypeCount> routes; // Indexed by RequestType; read-only once run() starts
+    RegistryClient registryClient;
+};
+
+// main() of a node binary: parses `<IP_ADDRESS> <PORT>` and the ServerConfig
+// flags over `defaults`, lets `install` register handlers, and serves.
+inline int runNode(int argc, char *argv[], ServerConfig defaults, const std::function<void(ServerCore &)> &install)
+{
+    ServerConfig config;
+    try
+    {
+        config = ServerConfig::parse(argc, argv, std::move(defaults));
+        if (config.arguments.size() == 2)
+        {
+            config.nodeIp = config.arguments[0];
+            config.port = ServerConfig::parsePort(config.arguments[1], "PORT");
+        }
+        if ((!config.arguments.empty() && config.arguments.size() != 2) || config.nodeIp.empty() || config.port == 0)
+        {
+            throw std::invalid_argument("Node IP and port are required");
+        }
+        config.resolvedMetricsPort();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <IP_ADDRESS> <PORT> [--config FILE] [--node-type TYPE]"
+                  << " [--registry-ip IP] [--registry-port PORT] [--reply-ip IP] [--ack-port PORT]"
+                  << " [--response-port PORT] [--heartbeat-ms MS] [--data-dir DIR]"
+                  << " [--metrics-address IP] [--metrics-port PORT]" << std::endl;
+        return 1;
+    }
+
+    ServerCore server(std::move(config));
+    install(server);
+    server.run();
+    return 0;
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+// Mergeable, bounded-memory sketches for per-area statistics.
+//
+// TDigest estimates quantiles (p50/p95/p99 AQI) from at most a few hundred
+// centroids; HyperLogLog estimates distinct counts (monitoring sites) from
+// 4096 one-byte registers. Both merge() with another sketch of the same kind,
+// which the store uses to combine pollutant partitions. toJson() exports the
+// centroids and the registers (register-wise max merges HyperLogLogs) for
+// "includeSketches" query responses; nodes do not read them back.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "json.hpp"
+
+// Stable 64-bit string hash (FNV-1a followed by a finalizer), so sketches built
+// by different nodes agree on the hash of the same site ID.
+inline uint64_t stableHash64(std::string_view value)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : value)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+class TDigest
+{
+public:
+    explicit TDigest(double compression = 100.0) : compression(compression) {}
+
+    // Non-finite values and weights are ignored: a NaN mean would break the
+    // ordering flush() sorts centroids by.
+    void add(double value, double weight = 1.0)
+    {
+        if (!std::isfinite(value) || !std::isfinite(weight) || weight <= 0.0)
+        {
+            return;
+        }
+        buffer.push_back({value, weight});
+        if (buffer.size() >= bufferLimit())
+        {
+            flush();
+        }
+    }
+
+    void merge(const TDigest &other)
+    {
+        buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+        buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+        flush();
+    }
+
+    // Folds buffered values into the centroid list.
+    void flush()
+    {
+        if (buffer.empty())
+        {
+            return;
+        }
+        std::vector<Centroid> all;
+        all.reserve(centroids.size() + buffer.size());
+        all.insert(all.end(), centroids.begin(), centroids.end());
+        all.insert(all.end(), buffer.begin(), buffer.end());
+        buffer.clear();
+        std::sort(all.begin(), all.end(), [](const Centroid &a, const Centroid &b)
+                  { return a.mean < b.mean; });
+
+        totalWeight = 0.0;
+        for (const auto &centroid : all)
+        {
+            totalWeight += centroid.weight;
+        }
+        minValue = std::min(minValue, all.front().mean);
+        maxValue = std::max(maxValue, all.back().mean);
+
+        centroids.clear();
+        Centroid current = all.front();
+        double weightSoFar = 0.0;
+        for (size_t i = 1; i < all.size(); ++i)
+        {
+            double proposed = current.weight + all[i].weight;
+            double qLeft = weightSoFar / totalWeight;
+            double qRight = (weightSoFar + proposed) / totalWeight;
+            if (scale(qRight) - scale(qLeft) <= 1.0)
+            {
+                current.mean += (all[i].mean - current.mean) * all[i].weight / proposed;
+                current.weight = proposed;
+            }
+            else
+            {
+                weightSoFar += current.weight;
+                centroids.push_back(current);
+                current = all[i];
+            }
+        }
+        centroids.push_back(current);
+    }
+
+    double quantile(double q) const
+    {
+        if (!buffer.empty())
+        {
+            TDigest flushed = *this;
+            flushed.flush();
+            return flushed.quantile(q);
+        }
+        if (centroids.empty())
+        {
+            return 0.0;
+        }
+        if (centroids.size() == 1)
+        {
+            return centroids.front().mean;
+        }
+
+        double target = std::clamp(q, 0.0, 1.0) * totalWeight;
+        double cumulative = 0.0;
+        for (size_t i = 0; i < centroids.size(); ++i)
+        {
+            double center = cumulative + centroids[i].weight / 2.0;
+            if (target < center)
+            {
+                if (i == 0)
+                {
+                    return minValue + (centroids[0].mean - minValue) * target / center;
+                }
+                double previousCenter = cumulative - centroids[i - 1].weight / 2.0;
+                double fraction = (target - previousCenter) / (center - previousCenter);
+                return centroids[i - 1].mean + (centroids[i].mean - centroids[i - 1].mean) * fraction;
+            }
+            cumulative += centroids[i].weight;
+        }
+        double lastCenter = totalWeight - centroids.back().weight / 2.0;
+        double fraction = (target - lastCenter) / (totalWeight - lastCenter);
+        return centroids.back().mean + (maxValue - centroids.back().mean) * fraction;
+    }
+
+    double count() const
+    {
+        double pending = 0.0;
+        for (const auto &centroid : buffer)
+        {
+            pending += centroid.weight;
+        }
+        return totalWeight + pending;
+    }
+
+    nlohmann::json toJson() const
+    {
+        TDigest flushed = *this;
+        flushed.flush();
+        nlohmann::json means = nlohmann::json::array();
+        nlohmann::json weights = nlohmann::json::array();
+        for (const auto &centroid : flushed.centroids)
+        {
+            means.push_back(centroid.mean);
+            weights.push_back(centroid.weight);
+        }
+        return {{"compression", compression}, {"min", flushed.minValue}, {"max", flushed.maxValue}, {"means", means}, {"weights", weights}};
+    }
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    // k1 scale function: small centroids at the tails, large in the middle.
+    double scale(double q) const
+    {
+        return compression / (2.0 * M_PI) * std::asin(2.0 * std::clamp(q, 0.0, 1.0) - 1.0);
+    }
+
+    size_t bufferLimit() const { return static_cast<size_t>(compression * 5); }
+
+    double compression;
+    std::vector<Centroid> centroids;
+    std::vector<Centroid> buffer;
+    double totalWeight = 0.0;
+    double minValue = std::numeric_limits<double>::infinity();
+    double maxValue = -std::numeric_limits<double>::infinity();
+};
+
+class HyperLogLog
+{
+public:
+    static constexpr int precision = 12;
+    static constexpr size_t registerCount = size_t(1) << precision;
+
+    void addHash(uint64_t hash)
+    {
+        size_t index = hash >> (64 - precision);
+        uint64_t remaining = (hash << precision) | (uint64_t(1) << (precision - 1));
+        uint8_t rank = static_cast<uint8_t>(__builtin_clzll(remaining) + 1);
+        if (rank > registers[index])
+        {
+            registers[index] = rank;
+        }
+    }
+
+    void merge(const HyperLogLog &other)
+    {
+        for (size_t i = 0; i < registerCount; ++i)
+        {
+            registers[i] = std::max(registers[i], other.registers[i]);
+        }
+    }
+
+    double estimate() const
+    {
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (uint8_t value : registers)
+        {
+            sum += std::ldexp(1.0, -value);
+            zeros += value == 0;
+        }
+        double m = static_cast<double>(registerCount);
+        double raw = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+        if (raw <= 2.5 * m && zeros > 0)
+        {
+            return m * std::log(m / zeros); // Linear counting for small cardinalities
+        }
+        return raw;
+    }
+
+    // Registers as a hex string (two characters per register).
+    nlohmann::json toJson() const
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string encoded(registerCount * 2, '0');
+        for (size_t i = 0; i < registerCount; ++i)
+        {
+            encoded[2 * i] = digits[registers[i] >> 4];
+            encoded[2 * i + 1] = digits[registers[i] & 0xf];
+        }
+        return encoded;
+    }
+
+private:
+    std::array<uint8_t, registerCount> registers{};
+};
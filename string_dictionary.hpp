@@ -0,0 +1,126 @@
+#pragma once
+
+// Concurrent string interning: maps repeated strings (areas, agencies, sites,
+// pollutants, ...) to dense 32-bit IDs so rows store integers instead of
+// string copies and grouping can index arrays by ID. Strings are never freed,
+// so only low-cardinality columns belong here; once a dictionary holds
+// maxChunks * chunkSize strings, intern() of a new one returns npos.
+//
+// intern() takes a shared lock on the hit path and an exclusive lock only the
+// first time a string is seen. lookup() is lock-free: strings live in
+// fixed-size chunks that are never moved once published.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class StringDictionary
+{
+public:
+    StringDictionary() : chunks(new std::atomic<std::string *>[maxChunks])
+    {
+        for (size_t i = 0; i < maxChunks; ++i)
+        {
+            chunks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~StringDictionary()
+    {
+        for (size_t i = 0; i < maxChunks; ++i)
+        {
+            delete[] chunks[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    StringDictionary(const StringDictionary &) = delete;
+    StringDictionary &operator=(const StringDictionary &) = delete;
+
+    // Returns the ID of `value`, adding it if new, or npos if the dictionary is full.
+    uint32_t intern(std::string_view value)
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = ids.find(value);
+            if (it != ids.end())
+            {
+                return it->second;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = ids.find(value);
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+
+        uint32_t id = count.load(std::memory_order_relaxed);
+        size_t chunkIndex = id >> chunkBits;
+        if (chunkIndex >= maxChunks)
+        {
+            return npos;
+        }
+        std::string *chunk = chunks[chunkIndex].load(std::memory_order_relaxed);
+        if (chunk == nullptr)
+        {
+            chunk = new std::string[chunkSize];
+            chunks[chunkIndex].store(chunk, std::memory_order_release);
+        }
+        std::string &stored = chunk[id & chunkMask];
+        stored.assign(value.data(), value.size());
+        ids.emplace(std::string_view(stored), id);
+        count.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    // Returns the ID of an already interned string, or npos.
+    uint32_t find(std::string_view value) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = ids.find(value);
+        return it == ids.end() ? npos : it->second;
+    }
+
+    const std::string &lookup(uint32_t id) const
+    {
+        return chunks[id >> chunkBits].load(std::memory_order_acquire)[id & chunkMask];
+    }
+
+    // Number of distinct strings; every ID below this is valid.
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+
+    static constexpr uint32_t npos = UINT32_MAX;
+
+private:
+    static constexpr size_t chunkBits = 12;
+    static constexpr size_t chunkSize = size_t(1) << chunkBits;
+    static constexpr size_t chunkMask = chunkSize - 1;
+    static constexpr size_t maxChunks = size_t(1) << 14; // 64M strings
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::unique_ptr<std::atomic<std::string *>[]> chunks;
+    std::atomic<uint32_t> count{0};
+};
+
+// One dictionary per column so the IDs of each column stay dense.
+struct StringDictionaries
+{
+    StringDictionary parameters;
+    StringDictionary units;
+    StringDictionary areas;
+    StringDictionary agencies;
+    StringDictionary sites;
+};
+
+inline StringDictionaries &dictionaries()
+{
+    static StringDictionaries instance;
+    return instance;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Synthetic AQI rows matching the 13-field schema sent by dummy_ingestion_client.
+// Like real AirNow data, every site reports every pollutant each hour: row n
+// of the sequence is area n % areaCount (one monitoring site each), pollutant
+// (n / areaCount) % 3, at hour n / (3 * areaCount) after 2020-01-01T00:00. The
+// sites therefore share hourly timestamps and no two rows are the same
+// reading. generateRows() returns rows firstRow .. firstRow + count - 1 with
+// random values. Used by the benchmark and the client's load-generation mode.
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+inline std::vector<std::vector<std::string>> generateRows(size_t count, std::mt19937 &rng, size_t firstRow = 0, int areaCount = 500)
+{
+    static const std::vector<std::string> parameters = {"PM2.5", "O3", "NO2"};
+    const std::time_t firstHour = 1577836800; // 2020-01-01T00:00Z
+    std::uniform_real_distribution<double> valueDist(0.0, 200.0);
+
+    std::vector<std::vector<std::string>> rows;
+    rows.reserve(count);
+    char timestamp[32] = "";
+    size_t formattedHour = SIZE_MAX;
+    for (size_t n = firstRow; n < firstRow + count; ++n)
+    {
+        int area = static_cast<int>(n % areaCount);
+        size_t parameter = (n / areaCount) % parameters.size();
+        size_t hour = n / (areaCount * parameters.size());
+        if (hour != formattedHour)
+        {
+            std::time_t time = firstHour + static_cast<std::time_t>(hour) * 3600;
+            std::tm utc{};
+            gmtime_r(&time, &utc);
+            std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M", &utc);
+            formattedHour = hour;
+        }
+        double value = valueDist(rng);
+        std::string site = std::to_string(840060150000ULL + area);
+        rows.push_back({timestamp,
+                        std::to_string(32.0 + (area % 500) * 0.02),
+                        std::to_string(-124.0 + (area % 500) * 0.015),
+                        parameters[parameter],
+                        std::to_string(value).substr(0, 5),
+                        "UG/M3",
+                        std::to_string(value * 1.04).substr(0, 5),
+                        std::to_string(static_cast<int>(value * 2.5)),
+                        std::to_string(1 + static_cast<int>(value) / 50),
+                        "Area " + std::to_string(area),
+                        "Air Quality Management District " + std::to_string(area % 40),
+                        site,
+                        site});
+    }
+    return rows;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// Hashed timer wheel for lease timeouts.
+//
+// Time is cut into fixed ticks and timers are hashed into slotCount slots by
+// the tick they are due in, so scheduling is O(1) and advancing the clock
+// only looks at the slots of the ticks that elapsed. Timers are never
+// cancelled: a renewed lease simply schedules a new timer, and the owner
+// ignores a firing whose lease has since been extended. Not thread-safe; the
+// owner serializes access.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+template <typename Key>
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(Clock::duration tick, size_t slotCount = 512, Clock::time_point start = Clock::now())
+        : tick(tick), start(start), slots(slotCount) {}
+
+    // Fires `key` on the first advance() at or after `deadline` (never earlier).
+    void schedule(const Key &key, Clock::time_point deadline)
+    {
+        uint64_t due = std::max(tickOf(deadline, true), currentTick + 1);
+        slots[due % slots.size()].push_back({key, due});
+        ++pending;
+    }
+
+    // Calls expired(key) for every timer due at or before `now`, in due order.
+    template <typename Callback>
+    void advance(Clock::time_point now, Callback expired)
+    {
+        uint64_t target = tickOf(now, false);
+        while (currentTick < target && pending > 0)
+        {
+            ++currentTick;
+            auto &slot = slots[currentTick % slots.size()];
+            for (size_t i = 0; i < slot.size();)
+            {
+                if (slot[i].due > currentTick)
+                {
+                    ++i; // Due in a later rotation of the wheel
+                    continue;
+                }
+                Key key = std::move(slot[i].key);
+                slot[i] = std::move(slot.back());
+                slot.pop_back();
+                --pending;
+                expired(key);
+            }
+        }
+        currentTick = std::max(currentTick, target);
+    }
+
+    size_t size() const { return pending; }
+
+private:
+    struct Timer
+    {
+        Key key;
+        uint64_t due;
+    };
+
+    uint64_t tickOf(Clock::time_point time, bool roundUp) const
+    {
+        if (time <= start)
+        {
+            return 0;
+        }
+        auto elapsed = time - start;
+        return static_cast<uint64_t>(elapsed / tick) + (roundUp && elapsed % tick != Clock::duration::zero() ? 1 : 0);
+    }
+
+    const Clock::duration tick;
+    const Clock::time_point start;
+    std::vector<std::vector<Timer>> slots;
+    uint64_t currentTick = 0;
+    size_t pending = 0;
+};